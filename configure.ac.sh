@@ -70,6 +70,18 @@ fi
 AC_MSG_RESULT([\$debug])
 " >> $CONFIG
 
+echo "
+AC_ARG_ENABLE([stats],
+              AC_HELP_STRING([--enable-stats], [Collect lookup and lock statistics, see var_stats() (default NO)]),
+              [stats=[yes]], [stats=[no]])
+
+AC_MSG_CHECKING([statistics])
+if test x\$stats == xyes ; then
+	AC_DEFINE(VAR_STATS, 1, [Collect statistics])
+fi
+AC_MSG_RESULT([\$stats])
+" >> $CONFIG
+
 echo "
 dnl Finally create all the generated files
 AC_CONFIG_FILES([ Makefile
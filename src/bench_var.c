@@ -0,0 +1,372 @@
+/*
+ * Part of libstrvar.
+ *
+ * License: MIT, see LICENSE
+ * Authors: Antti Partanen <aehparta@cc.hut.fi, duge at IRCnet>
+ */
+
+/******************************************************************************/
+/* INCLUDES */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "strvar.h"
+
+
+/******************************************************************************/
+/* VARIABLES */
+/* operations benchmarked */
+enum
+{
+	BENCH_SET_STR,
+	BENCH_GET_STR,
+	BENCH_GET_NUM,
+	BENCH_PARSE,
+	BENCH_FILE,
+	BENCH_OPS
+};
+static const char *bench_names[BENCH_OPS] = { "varl_set_str", "varl_get_str", "varl_get_num", "varl_parse", "varl_file" };
+/* templates for varl_parse(), referring to other items */
+#define BENCH_TEMPLATES 1000
+/* State of one benchmark thread. */
+struct bench_thread
+{
+	pthread_t thread;
+	int op;
+	int id;
+	size_t keys;
+	size_t ops;
+	/* latency of each operation in nanoseconds */
+	uint64_t *lat;
+	struct timespec start;
+	struct timespec end;
+	uint32_t seed;
+};
+static var_list_t bench_list;
+static pthread_barrier_t bench_barrier;
+static char bench_dir[] = "/tmp/benchvarXXXXXX";
+
+
+/******************************************************************************/
+/* FUNCTIONS */
+
+/******************************************************************************/
+/**
+ * Nanoseconds from a to b.
+ */
+static uint64_t bench_ns(struct timespec *a, struct timespec *b)
+{
+	return (uint64_t)((int64_t)(b->tv_sec - a->tv_sec) * 1000000000LL + (b->tv_nsec - a->tv_nsec));
+}
+
+
+/******************************************************************************/
+/**
+ * Pseudo random number for choosing keys.
+ */
+static uint32_t bench_rand(uint32_t *seed)
+{
+	*seed ^= *seed << 13;
+	*seed ^= *seed >> 17;
+	*seed ^= *seed << 5;
+	return *seed;
+}
+
+
+/******************************************************************************/
+/**
+ * Sort latencies.
+ */
+static int bench_cmp(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+
+/******************************************************************************/
+/**
+ * Name of file loaded by given thread.
+ */
+static void bench_file_name(char *name, size_t size, int id)
+{
+	snprintf(name, size, "%s/bench%d.ini", bench_dir, id);
+}
+
+
+/******************************************************************************/
+/**
+ * Write file with given number of keys for varl_file(), to list of its own
+ * for each thread.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int bench_file_write(int id, size_t keys)
+{
+	char name[256];
+	size_t i;
+	FILE *f;
+
+	bench_file_name(name, sizeof(name), id);
+	f = fopen(name, "w");
+	if (!f) return -1;
+	fprintf(f, "[benchfile%d]\n", id);
+	for (i = 0; i < keys; i++) fprintf(f, "k%zu = value of key %zu\n", i, i);
+	fclose(f);
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Set items that operations use: strings k<n>, numbers n<n> and
+ * templates p<n>.
+ */
+static void bench_fill(size_t keys)
+{
+	char name[32];
+	size_t i;
+
+	varl_clear(bench_list);
+	for (i = 0; i < keys; i++)
+	{
+		snprintf(name, sizeof(name), "k%zu", i);
+		varl_set_str(bench_list, name, "value of key %zu", i);
+		snprintf(name, sizeof(name), "n%zu", i);
+		varl_set_num(bench_list, name, (double)i / 3.0);
+	}
+	for (i = 0; i < BENCH_TEMPLATES; i++)
+	{
+		snprintf(name, sizeof(name), "p%zu", i);
+		varl_set_str(bench_list, name, "first $k%zu and then $n%zu done", i % keys, (i * 7) % keys);
+	}
+}
+
+
+/******************************************************************************/
+/**
+ * Run operations of one thread.
+ */
+static void *bench_run(void *arg)
+{
+	struct bench_thread *t = (struct bench_thread *)arg;
+	struct timespec a, b;
+	char name[256];
+	const char *p;
+	size_t i;
+
+	if (t->op == BENCH_FILE) bench_file_name(name, sizeof(name), t->id);
+	pthread_barrier_wait(&bench_barrier);
+
+	clock_gettime(CLOCK_MONOTONIC, &t->start);
+	for (i = 0; i < t->ops; i++)
+	{
+		switch (t->op)
+		{
+		case BENCH_SET_STR:
+		case BENCH_GET_STR:
+			snprintf(name, sizeof(name), "k%u", bench_rand(&t->seed) % (unsigned int)t->keys);
+			break;
+		case BENCH_GET_NUM:
+			snprintf(name, sizeof(name), "n%u", bench_rand(&t->seed) % (unsigned int)t->keys);
+			break;
+		case BENCH_PARSE:
+			snprintf(name, sizeof(name), "p%u", bench_rand(&t->seed) % BENCH_TEMPLATES);
+			break;
+		}
+
+		clock_gettime(CLOCK_MONOTONIC, &a);
+		switch (t->op)
+		{
+		case BENCH_SET_STR:
+			varl_set_str(bench_list, name, "new value %u", (unsigned int)i);
+			break;
+		case BENCH_GET_STR:
+			varl_get_str(bench_list, name);
+			break;
+		case BENCH_GET_NUM:
+			varl_get_num(bench_list, name);
+			break;
+		case BENCH_PARSE:
+			p = varl_parse(bench_list, name, (void *)-1);
+			if (p && *p) var_free((void *)p);
+			break;
+		case BENCH_FILE:
+			varl_file(name, NULL);
+			break;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &b);
+		t->lat[i] = bench_ns(&a, &b);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &t->end);
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/**
+ * Run one operation with given number of threads and print result as
+ * CSV line.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int bench_case(int op, size_t keys, int threads, size_t ops)
+{
+	struct bench_thread *t;
+	int64_t first, last, d;
+	uint64_t *lat, wall;
+	size_t n, i;
+	int j, err = 0;
+
+	t = (struct bench_thread *)calloc(threads, sizeof(*t));
+	lat = (uint64_t *)malloc(sizeof(*lat) * ops * threads);
+	if (!t || !lat) goto out_err;
+	if (pthread_barrier_init(&bench_barrier, NULL, threads)) goto out_err;
+
+	for (j = 0; j < threads; j++)
+	{
+		t[j].op = op;
+		t[j].id = j;
+		t[j].keys = keys;
+		t[j].ops = ops;
+		t[j].lat = &lat[ops * j];
+		t[j].seed = 2463534242U + j;
+		if (pthread_create(&t[j].thread, NULL, bench_run, &t[j]))
+		{
+			/* Barrier would never open, so give up. */
+			fprintf(stderr, "benchvar: failed to start thread\n");
+			exit(1);
+		}
+	}
+	for (j = 0; j < threads; j++) pthread_join(t[j].thread, NULL);
+	pthread_barrier_destroy(&bench_barrier);
+
+	/* Wall time is from first thread starting to last one ending. */
+	first = 0;
+	last = 0;
+	for (j = 0; j < threads; j++)
+	{
+		d = (int64_t)bench_ns(&t[0].start, &t[j].start);
+		if (d < first) first = d;
+		d = (int64_t)bench_ns(&t[0].start, &t[j].end);
+		if (d > last) last = d;
+	}
+	wall = (uint64_t)(last - first);
+
+	n = ops * threads;
+	qsort(lat, n, sizeof(*lat), bench_cmp);
+	i = n * 99 / 100;
+	printf("%s,%zu,%d,%zu,%.6f,%.0f,%llu,%llu\n", bench_names[op], keys, threads, n,
+	       (double)wall / 1e9, wall ? (double)n * 1e9 / wall : 0.0,
+	       (unsigned long long)lat[n / 2], (unsigned long long)lat[i < n ? i : n - 1]);
+	fflush(stdout);
+	goto out;
+
+out_err:
+	err = -1;
+out:
+	if (t) free(t);
+	if (lat) free(lat);
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Print usage.
+ */
+static void bench_usage(const char *name)
+{
+	fprintf(stderr,
+	        "usage: %s [-k max_keys] [-t max_threads] [-n ops]\n"
+	        "  -k  largest list size, sizes go from 10 up by factor of 10 (default 1000000)\n"
+	        "  -t  most threads, counts go from 1 up by factor of 2 (default CPU count)\n"
+	        "  -n  operations per thread in each case (default 100000)\n"
+	        "Results are printed as CSV to stdout.\n", name);
+}
+
+
+/******************************************************************************/
+/** Main. */
+int main(int argc, char *argv[])
+{
+	size_t max_keys = 1000000, ops = 100000, keys, n;
+	int max_threads, threads, written, op, c;
+	char name[256];
+
+	max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (max_threads < 1) max_threads = 1;
+
+	while ((c = getopt(argc, argv, "k:t:n:h")) != -1)
+	{
+		switch (c)
+		{
+		case 'k':
+			max_keys = strtoul(optarg, NULL, 10);
+			break;
+		case 't':
+			max_threads = atoi(optarg);
+			break;
+		case 'n':
+			ops = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			bench_usage(argv[0]);
+			return 1;
+		}
+	}
+	if (max_keys < 10 || max_threads < 1 || ops < 1)
+	{
+		bench_usage(argv[0]);
+		return 1;
+	}
+
+	if (var_init()) return 1;
+	bench_list = varl_new("bench");
+	if (bench_list < 0 || !mkdtemp(bench_dir))
+	{
+		fprintf(stderr, "benchvar: setup failed\n");
+		return 1;
+	}
+
+	printf("op,keys,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns\n");
+	for (keys = 10; keys <= max_keys; keys *= 10)
+	{
+		bench_fill(keys);
+		for (threads = 1; threads <= max_threads; threads *= 2)
+		{
+			for (op = 0; op < BENCH_PARSE + 1; op++) bench_case(op, keys, threads, ops);
+		}
+
+		/* Loading whole file is one operation, so do less of them. */
+		n = ops / keys;
+		if (n < 1) n = 1;
+		if (n > 1000) n = 1000;
+		for (written = 0, threads = 1; threads <= max_threads; threads *= 2)
+		{
+			for ( ; written < threads; written++)
+			{
+				if (bench_file_write(written, keys)) fprintf(stderr, "benchvar: failed to write file\n");
+			}
+			bench_case(BENCH_FILE, keys, threads, n);
+		}
+	}
+
+	for (c = 0; c < max_threads; c++)
+	{
+		bench_file_name(name, sizeof(name), c);
+		unlink(name);
+	}
+	rmdir(bench_dir);
+	var_quit();
+
+	return 0;
+}
+
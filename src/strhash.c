@@ -56,15 +56,29 @@ static inline unsigned long _hl_hash(int max, unsigned char *str)
 }
 
 
+/******************************************************************************/
+/**
+ * Internal help routine: Free item and its data.
+ * Small data is stored in item itself.
+ */
+static inline void _hl_item_free(struct var_item *v)
+{
+	if (v->data && v->data != v->small) free(v->data);
+	free(v);
+}
+
+
 /******************************************************************************/
 /**
  * Internal help routine: Copy data from item to another.
+ * Data that fits to small buffer of list item is stored there.
  */
 static inline void *_hl_item_data_copy(struct var_item *dst, struct var_item *src)
 {
-	if (src->size > dst->size)
+	if (dst->data == dst->small && src->size <= VAR_ITEM_SMALL);
+	else if (src->size > dst->size)
 	{
-		if (dst->data) free(dst->data);
+		if (dst->data && dst->data != dst->small) free(dst->data);
 		dst->data = malloc(src->size);
 		dst->size = 0;
 		if (!dst->data) return;
@@ -77,17 +91,35 @@ static inline void *_hl_item_data_copy(struct var_item *dst, struct var_item *sr
 }
 
 
+/******************************************************************************/
+/**
+ * Internal help routine: Give data of item to another.
+ */
+static inline void *_hl_item_data_own(struct var_item *dst, struct var_item *src)
+{
+	if (dst->data && dst->data != dst->small) free(dst->data);
+	dst->data = src->data;
+	dst->size = src->size;
+	dst->type = src->type;
+
+	return dst->data;
+}
+
+
 /******************************************************************************/
 /**
  * Internal help routine: Find/add from/to hashlist.
  *
+ * @param list Hashlist.
+ * @param key Key to find, not used with HASH_DOPOP.
+ * @param item Item holding data for put or receiving data for get.
  * @return Non-zero if found.
  */
-int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **datapr)
+int _hl_find(struct var_hashlist *list, const void *key, struct var_item *item, int _do, void **datapr)
 {
 	struct var_item *loop, *from = NULL, *to = NULL;
 	unsigned long hash;
-	int err = 0;
+	int err = 0, keylen;
 	void *datap = NULL;
 	
 	lock_write(&list->lock);
@@ -116,8 +148,8 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 					list->items[i] = from->next;
 					list->items[i]->prev = NULL;
 				}
-				*datapr = from->data;
-				free(from);
+				*datapr = p;
+				_hl_item_free(from);
 				err = 1;
 				break;
 			}
@@ -128,12 +160,13 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 	}
 
 	/* calculate hash first. */
-	hash = list->f_hash(list->size, item->key);
+	hash = list->f_hash(list->size, (void *)key);
+	keylen = list->f_keylen((void *)key);
 	
 	for (loop = list->items[hash]; loop; loop = loop->next)
 	{
-		if (list->f_keylen(loop->key) != list->f_keylen(item->key));
-		else if (memcmp(loop->key, item->key, list->f_keylen(item->key)) == 0)
+		if (loop->keylen != keylen);
+		else if (memcmp(loop->key, key, keylen) == 0)
 		{
 			switch (_do)
 			{
@@ -147,6 +180,11 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 				from = item;
 				to = loop;
 				break;
+
+			case HASH_DOOWN:
+				datap = _hl_item_data_own(loop, item);
+				err = 1;
+				goto out_err;
 				
 			case HASH_DOINC:
 				if (loop->type == VAR_TYPE_NUM)
@@ -181,8 +219,7 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 						list->items[hash] = from->next;
 						list->items[hash]->prev = NULL;
 					}
-					free(from->data);
-					free(from);
+					_hl_item_free(from);
 				}
 				err = 1;
 				goto out_err;
@@ -201,13 +238,20 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 	}
 
 	/* do add of new item (loop should not be null if possible ) */
-	if (_do == HASH_DOPUT || _do == HASH_DOINC)
+	if (_do == HASH_DOPUT || _do == HASH_DOINC || _do == HASH_DOOWN)
 	{
-		to = (struct var_item *)malloc(sizeof(*to));
+		to = (struct var_item *)malloc(VAR_ITEM_ALLOC(keylen));
 		IF_ER(!to, 0);
-		memset(to, 0, sizeof(*to));
-		memcpy(to->key, item->key, list->f_keylen(item->key));
-		datap = _hl_item_data_copy(to, item);
+		memset(to, 0, VAR_ITEM_SIZE);
+		memcpy(to->key, key, keylen);
+		to->key[keylen] = '\0';
+		to->keylen = keylen;
+		if (_do == HASH_DOOWN) datap = _hl_item_data_own(to, item);
+		else
+		{
+			if (item->size <= VAR_ITEM_SMALL) to->data = to->small;
+			datap = _hl_item_data_copy(to, item);
+		}
 	
 		if (!list->items[hash]) list->items[hash] = to;
 		else if (loop)
@@ -219,6 +263,8 @@ int _hl_find(struct var_hashlist *list, struct var_item *item, int _do, void **d
 
 out_err:
 	lock_unlock(&list->lock);
+	/* Data that was not given to item is freed. */
+	if (_do == HASH_DOOWN && !datap) free(item->data);
 	if (datapr) *datapr = datap;
 	return err;
 }
@@ -234,15 +280,14 @@ void *_hl_putb(struct var_hashlist *list, const void *key, const void *data, int
 	void *datap = NULL;
 
 	/* Setup new hashlist item. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
+	memset(&item, 0, sizeof(item));
 	item.data = (void *)data;
 	item.size = size;
 	item.type = type;
 
 	/* Add new item to list. */
 	
-	_hl_find(list, &item, HASH_DOPUT, &datap);
+	_hl_find(list, key, &item, HASH_DOPUT, &datap);
 	return datap;
 }
 
@@ -256,14 +301,13 @@ void _hl_putn(struct var_hashlist *list, const void *key, double value, int _do)
 	struct var_item item;
 	
 	/* Setup new hashlist item. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
+	memset(&item, 0, sizeof(item));
 	item.data = &value;
 	item.size = sizeof(value);
 	item.type = VAR_TYPE_NUM;
 
 	/* Add new item to list. */
-	_hl_find(list, &item, _do, NULL);
+	_hl_find(list, key, &item, _do, NULL);
 }
 
 
@@ -331,8 +375,7 @@ void var_lh_clear(struct var_hashlist *list)
 				{
 					list->f_free(list, v1->key, *((void **)v1->data));
 				}
-				if (v1->data) free(v1->data);
-				free(v1);
+				_hl_item_free(v1);
 			}
 			list->items[i] = NULL;
 		}
@@ -388,6 +431,32 @@ void *var_lh_putb(struct var_hashlist *list, const void *key, const void *data,
 }
 
 
+/******************************************************************************/
+/**
+ * Put data into hashlist without copying it. List takes ownership of
+ * data and frees it when item is removed, or right away on errors.
+ *
+ * @param list List to be used.
+ * @param key Key to be used.
+ * @param data Data allocated with malloc().
+ * @param size Size of data.
+ * @return Pointer to data, or NULL on errors.
+ */
+void *var_lh_put_own(struct var_hashlist *list, const void *key, void *data, size_t size)
+{
+	struct var_item item;
+	void *datap = NULL;
+
+	memset(&item, 0, sizeof(item));
+	item.data = data;
+	item.size = size;
+	item.type = VAR_TYPE_BIN;
+
+	_hl_find(list, key, &item, HASH_DOOWN, &datap);
+	return datap;
+}
+
+
 /******************************************************************************/
 /**
  * Set pointer value as hashlist item.
@@ -439,13 +508,10 @@ void *var_lh_getp(struct var_hashlist *list, const void *key)
 	struct var_item item;
 
 	/* Setup hashlist item for search. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
-	item.data = NULL;
-	item.size = 0;
+	memset(&item, 0, sizeof(item));
 	
 	/* Find item. */
-	if (_hl_find(list, &item, HASH_GETITEM, NULL))
+	if (_hl_find(list, key, &item, HASH_GETITEM, NULL))
 	{
 		return *((void **)item.data);
 	}
@@ -463,13 +529,10 @@ int var_lh_get_int(struct var_hashlist *list, const void *key)
 	struct var_item item;
 
 	/* Setup hashlist item for search. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
-	item.data = NULL;
-	item.size = 0;
+	memset(&item, 0, sizeof(item));
 
 	/* Find item. */
-	if (_hl_find(list, &item, HASH_GETITEM, NULL))
+	if (_hl_find(list, key, &item, HASH_GETITEM, NULL))
 	{
 		return (int)atoi(item.data);
 	}
@@ -498,8 +561,7 @@ int var_lh_get(struct var_hashlist *list, const void *key, void **data, size_t *
 	struct var_item item;
 
 	/* Setup hashlist item for search. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
+	memset(&item, 0, sizeof(item));
 	if (size && *data) 
 	{
 		item.data = *data;
@@ -513,7 +575,7 @@ int var_lh_get(struct var_hashlist *list, const void *key, void **data, size_t *
 	}
 
 	/* Find item. */
-	if (_hl_find(list, &item, HASH_DOGET, NULL))
+	if (_hl_find(list, key, &item, HASH_DOGET, NULL))
 	{
 		*data = item.data;
 		if (size) *size = item.size;
@@ -609,7 +671,7 @@ void var_lh_dump(struct var_hashlist *list)
 			{
 				sprintf(key, "%d", *((int *) v->key));
 			}
-			else strcpy(key, v->key);
+			else snprintf(key, sizeof(key), "%s", v->key);
 			printf("   %d. key \'%s\', type \'%s\', size %d, content \'%s\'\n", j, key, type, (int)v->size, content);
 		}
 	}
@@ -716,27 +778,20 @@ int var_lh_rm(hashl_t list, const void *key)
 	struct var_item item;
 
 	/* Setup hashlist item for search. */
-	memset(item.key, 0, sizeof(item.key));
-	memcpy(item.key, key, list->f_keylen((void *)key));
-	item.data = NULL;
-	item.size = 0;
+	memset(&item, 0, sizeof(item));
 
 	/* Find item. */
-	return _hl_find(list, &item, HASH_DORM, NULL);
+	return _hl_find(list, key, &item, HASH_DORM, NULL);
 }
 
 
 /******************************************************************************/
 void *var_lh_popp(hashl_t list)
 {
-	void *data = NULL, *p = NULL;
+	void *p = NULL;
 
-	/* Find item. */
-	if (_hl_find(list, NULL, HASH_DOPOP, &data))
-	{
-		p = *((void **)data);
-		free(data);
-	}
+	/* Find item, pointer is stored to p. */
+	if (!_hl_find(list, NULL, NULL, HASH_DOPOP, &p)) return NULL;
 
 	return p;
 }
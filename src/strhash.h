@@ -28,6 +28,7 @@ extern "C" {
 #define HASH_GETITEM			3
 #define HASH_DORM				4
 #define HASH_DOPOP				5
+#define HASH_DOOWN				6
 
 
 /******************************************************************************/
@@ -66,6 +67,7 @@ hashl_t var_lh_new(int length, unsigned long (*key_hash)(int, void *), int (*key
 void var_lh_free(hashl_t list);
 void *var_lh_puta(hashl_t list, const void *key, const char *string);
 void *var_lh_putb(hashl_t list, const void *key, const void *data, size_t size);
+void *var_lh_put_own(hashl_t list, const void *key, void *data, size_t size);
 void var_lh_setp(hashl_t list, const void *key, void *pointer);
 void var_lh_setnum(hashl_t list, const void *key, double value);
 void var_lh_addnum(hashl_t list, const void *key, double value);
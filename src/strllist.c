@@ -16,7 +16,11 @@
 /* FUNCTIONS */
 
 /******************************************************************************/
-int _var_ll_app(struct var_llist *list, void *data, size_t len, int type)
+/**
+ * Internal help routine: Append item to list.
+ * Binary data is copied, unless own is set, and then it is given to list.
+ */
+static int _var_ll_add(struct var_llist *list, void *data, size_t len, int type, int own)
 {
 	struct var_llist_item *item;
 
@@ -30,7 +34,7 @@ int _var_ll_app(struct var_llist *list, void *data, size_t len, int type)
 	{
 		item->data = data;
 	}
-	else if (type != VAR_TYPE_STR)
+	else if (type != VAR_TYPE_STR && !own)
 	{
 		item->data = malloc(len);
 		if (!item->data)
@@ -61,6 +65,13 @@ int _var_ll_app(struct var_llist *list, void *data, size_t len, int type)
 }
 
 
+/******************************************************************************/
+int _var_ll_app(struct var_llist *list, void *data, size_t len, int type)
+{
+	return _var_ll_add(list, data, len, type, 0);
+}
+
+
 /******************************************************************************/
 struct var_llist *var_ll_new(void)
 {
@@ -106,6 +117,19 @@ int var_ll_app_bin(struct var_llist *list, void *data, size_t len)
 }
 
 
+/******************************************************************************/
+int var_ll_app_own(struct var_llist *list, void *data, size_t len)
+{
+	if (_var_ll_add(list, data, len, VAR_TYPE_BIN, 1))
+	{
+		free(data);
+		return -1;
+	}
+
+	return 0;
+}
+
+
 /******************************************************************************/
 int var_ll_app_p(linkedl_t list, void *pointer)
 {
@@ -68,6 +68,16 @@ int var_ll_app(linkedl_t list, const char *string, ...);
  */
 int var_ll_app_bin(linkedl_t list, void *data, size_t len);
 
+/**
+ * Append binary data at end of the list without copying it.
+ * List takes ownership of data, it is freed right away on errors.
+ *
+ * @param list Linked list.
+ * @param data Pointer to data allocated with malloc().
+ * @param len Data length.
+ */
+int var_ll_app_own(linkedl_t list, void *data, size_t len);
+
 /**
  * Append new pointer at end of the list.
  */
@@ -8,6 +8,14 @@
 /******************************************************************************/
 /* INCLUDES */
 #include <ddebug/synchro.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <time.h>
+#include <limits.h>
 #include "strvar.h"
 #include <ddebug/strlens.h>
 #include "strcalc.h"
@@ -19,15 +27,201 @@
 #define PRINTF
 #endif
 
+/* count events for var_stats(), when compiled with --enable-stats */
+#ifdef VAR_STATS
+#define VAR_STAT_ADD(counter, n) __atomic_add_fetch(&(counter), (n), __ATOMIC_RELAXED)
+#else
+#define VAR_STAT_ADD(counter, n)
+#endif
+
 
 /******************************************************************************/
 /* VARIABLES */
-/* Variable array container. */
-static struct var_list *var_list = NULL;
+/*
+ * Variable array container. Lists are stored in chunks that double in size,
+ * so lists never move in memory once created and can be used without
+ * holding var_list_lock.
+ */
+static struct var_list *var_list[VAR_LIST_CHUNKS];
 /* Variable array size. */
 static int var_list_c = 0;
-/* Lock for variable array. */
+/* Lock for variable array growth and list name index. */
 static lock_t var_list_lock;
+/* Index of named lists, each slot is first list ID in chain or -1. */
+static var_list_t *var_list_names = NULL;
+/* Size of list name index, always power of 2. */
+static size_t var_list_names_size = 0;
+/*
+ * Readers of lists do not lock, instead they announce the epoch they
+ * entered reading in. Memory removed from lists is retired with current
+ * epoch and freed when no reader is left in that or an older epoch.
+ * Epoch 0 means that reader is not reading.
+ */
+struct var_reader
+{
+	unsigned long epoch;
+	int nest;
+	int used;
+	struct var_reader *next;
+	/* memory retired by this reader, see _v_retire_local() */
+	struct var_retire *retired;
+	size_t retired_c;
+	size_t retired_size;
+	/* overlay list of thread and lists it shadows, see var_overlay_begin() */
+	struct var_list *overlay;
+	var_list_t *shadow;
+	int shadow_c;
+	int shadow_size;
+};
+/* Current epoch. */
+static unsigned long var_epoch = 1;
+/* Oldest epoch still being read, when last checked. */
+static unsigned long var_epoch_safe = 0;
+/* Changed whenever lists are cleared or copied, see struct var_tmpl_tok. */
+static unsigned long var_items_version = 0;
+/* Changed whenever item with key of slot is added or removed, see _v_key_changed(). */
+static unsigned int var_key_versions[VAR_KEY_VERSIONS];
+/*
+ * Global index of keys in all lists. Data of each item is array of IDs of
+ * lists that have item with the key, in ascending order. Index is set
+ * when lists are changed, so finding from all lists does not need to go
+ * trough lists that do not have the item. Index is split to stripes by
+ * hash of key, so writers of different keys do not wait for each other.
+ */
+static struct var_list var_keys[VAR_KEYS_STRIPES];
+/* Set if index could not be kept up to date, lists are then searched. */
+static int var_keys_lost = 0;
+/* Counters of var_stats() that do not belong to any list. */
+static uint64_t var_stat_list_lock_wait = 0;
+static uint64_t var_stat_expands = 0;
+static uint64_t var_stat_memo_hits = 0;
+#ifdef VAR_STATS
+/* Items compared by calling thread while finding, see _v_find_in(). */
+static __thread uint64_t var_stat_scanned = 0;
+#endif
+/* Reader records, never freed, records of exited threads are reused. */
+static struct var_reader *var_readers = NULL;
+/* Reader record of calling thread. */
+static __thread struct var_reader *var_reader = NULL;
+/* Lists calling thread iterates with varl_iter_begin(), see _v_lock_list(). */
+static __thread struct var_list *var_iter_lists[VAR_ITER_MAX];
+static __thread int var_iter_c = 0;
+/* Key used to release reader record when thread exits. */
+static pthread_key_t var_reader_key;
+static pthread_once_t var_reader_once = PTHREAD_ONCE_INIT;
+/* String builder, see _v_buf_add(). */
+struct var_buf
+{
+	char *p;
+	size_t len;
+	size_t size;
+};
+/* State of one varl_parsev() call. */
+struct var_parse
+{
+	struct var_buf b;
+	/* items result is parsed from */
+	struct var_memo_dep *dep;
+	size_t dep_c;
+	size_t dep_size;
+	unsigned long version;
+	/* set if results can be memoized, not while overlay is active */
+	int cache;
+	/* count of times parsing stopped to recursion */
+	int cut;
+	int err;
+};
+/* State of one varl_file_prefunc() call. */
+struct var_file
+{
+	var_list_t list;
+	/* names and values are terminated in these for prefunc and lists */
+	struct var_buf name;
+	struct var_buf value;
+	int (*prefunc)(var_list_t, const char *, const char *);
+	int (*prefunc_n)(var_list_t, const char *, size_t, const char *, size_t);
+};
+/* Line of file parsed by varl_files_parallel(), value is -1 for lists. */
+struct var_stage_line
+{
+	size_t name;
+	size_t value;
+};
+/* File parsed by varl_files_parallel(), before it is set to lists. */
+struct var_stage
+{
+	const char *file;
+	/* names and values, null terminated */
+	struct var_buf b;
+	struct var_stage_line *line;
+	size_t line_c;
+	size_t line_size;
+	int err;
+	int done;
+};
+/* Files shared by workers of varl_files_parallel(). */
+struct var_stage_pool
+{
+	struct var_stage *stage;
+	size_t count;
+	size_t next;
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+};
+/* Header of snapshot file, followed by lists and then their items. */
+struct var_snapshot_head
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t lists;
+	/* structs are stored as is, so they must match */
+	uint32_t ptr_size;
+	uint32_t item_size;
+	/* address pointers in file are for */
+	uint64_t base;
+	uint64_t size;
+};
+/* List in snapshot file. */
+struct var_snapshot_list
+{
+	char name[260];
+	int flags;
+	uint64_t count;
+	struct var_item *first;
+	struct var_item **hash;
+	uint64_t hash_size;
+	struct var_trie *trie;
+};
+/* Variable of parsed file in diff of two parses, see _v_stage_diff(). */
+struct var_diff
+{
+	const char *list;
+	const char *key;
+	const char *value;
+	unsigned int hash;
+	int seen;
+};
+/* File watched for changes, see var_watch_file(). */
+struct var_watch
+{
+	char *path;
+	/* name of file in its directory, points to path */
+	const char *name;
+	/* watch of directory, so that files replaced by rename are noticed */
+	int wd;
+	/* set when file has changed since last loaded */
+	int changed;
+	/* file as it was when last loaded, and its variables by list and key */
+	struct var_stage stage;
+	struct var_diff *index;
+	size_t index_size;
+};
+/* Watched files, guarded by var_watch_lock. */
+static struct var_watch *var_watches = NULL;
+static size_t var_watch_c = 0;
+static size_t var_watch_size = 0;
+static int var_watch_inotify = -1;
+static lock_t var_watch_lock;
 /* Constant empty variable string for internal use. */
 static char *var_empty_string = "";
 /* settings */
@@ -40,6 +234,316 @@ static void *vopt[VAR_OPT_C] =
 /******************************************************************************/
 /* FUNCTIONS */
 
+/******************************************************************************/
+/**
+ * Internal help routine: Get count of lists.
+ * Can be used without holding var_list_lock.
+ */
+static inline int _v_lists(void)
+{
+	return __atomic_load_n(&var_list_c, __ATOMIC_ACQUIRE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get list by ID.
+ * Chunk k holds VAR_LIST_CHUNK_MIN << k lists.
+ * @note Wont check that list ID is valid.
+ */
+static inline struct var_list *_v_list(var_list_t list)
+{
+	unsigned int k = 31 - __builtin_clz((unsigned int)list / VAR_LIST_CHUNK_MIN + 1);
+	return &var_list[k][list - VAR_LIST_CHUNK_MIN * ((1U << k) - 1)];
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Nanoseconds since given time, for var_stats().
+ */
+static inline uint64_t _v_stat_since(struct timespec *t)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)((int64_t)(now.tv_sec - t->tv_sec) * 1000000000LL + (now.tv_nsec - t->tv_nsec));
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Lock for writing. With statistics enabled, time
+ * waited is added to given counter.
+ */
+static inline void _v_lock_write(lock_t *lock, uint64_t *wait)
+{
+#ifdef VAR_STATS
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	lock_write(lock);
+	VAR_STAT_ADD(*wait, _v_stat_since(&t));
+#else
+	lock_write(lock);
+#endif
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Lock for reading, see _v_lock_write().
+ */
+static inline void _v_lock_read(lock_t *lock, uint64_t *wait)
+{
+#ifdef VAR_STATS
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	lock_read(lock);
+	VAR_STAT_ADD(*wait, _v_stat_since(&t));
+#else
+	lock_read(lock);
+#endif
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether calling thread iterates list.
+ *
+ * @param l List, or NULL for any list.
+ * @return 1 if it does, 0 if not.
+ */
+static int _v_iterating(struct var_list *l)
+{
+	int i;
+
+	for (i = 0; i < var_iter_c; i++)
+	{
+		if (!l || var_iter_lists[i] == l) return 1;
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Lock list for writing. Thread iterating list
+ * holds its read lock, and would wait for itself.
+ *
+ * @return 0 on success, -1 if calling thread iterates list.
+ */
+static int _v_lock_list(struct var_list *l)
+{
+	if (_v_iterating(l)) return -1;
+	_v_lock_write(&l->lock, &l->stats.lock_wait_ns);
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Release reader record of exiting thread.
+ */
+static void _v_reader_exit(void *p)
+{
+	struct var_reader *r = (struct var_reader *)p;
+
+	__atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+	r->nest = 0;
+	/* Overlay is reset when next thread using this record begins one. */
+	r->shadow_c = 0;
+	__atomic_store_n(&r->used, 0, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Create key for releasing reader records.
+ */
+static void _v_reader_key(void)
+{
+	pthread_key_create(&var_reader_key, _v_reader_exit);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get reader record of calling thread.
+ * Record is taken from released ones or allocated on first call.
+ *
+ * @return Reader record, or NULL on errors.
+ */
+static struct var_reader *_v_reader(void)
+{
+	struct var_reader *r;
+	int unused;
+
+	if (var_reader) return var_reader;
+
+	/* Try to reuse record of some exited thread. */
+	for (r = __atomic_load_n(&var_readers, __ATOMIC_ACQUIRE); r; r = r->next)
+	{
+		unused = 0;
+		if (__atomic_compare_exchange_n(&r->used, &unused, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) break;
+	}
+
+	if (!r)
+	{
+		r = (struct var_reader *)malloc(sizeof(*r));
+		if (!r) return NULL;
+		memset(r, 0, sizeof(*r));
+		r->used = 1;
+		r->next = __atomic_load_n(&var_readers, __ATOMIC_ACQUIRE);
+		while (!__atomic_compare_exchange_n(&var_readers, &r->next, r, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+	}
+
+	pthread_once(&var_reader_once, _v_reader_key);
+	pthread_setspecific(var_reader_key, r);
+	var_reader = r;
+
+	return r;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Start new epoch and find oldest epoch still
+ * being read. Nothing from epochs before it can be seen by readers.
+ *
+ * @return Oldest epoch being read.
+ */
+static unsigned long _v_epoch_min(void)
+{
+	struct var_reader *rd;
+	unsigned long min, e;
+
+	min = __atomic_add_fetch(&var_epoch, 1, __ATOMIC_SEQ_CST);
+	for (rd = __atomic_load_n(&var_readers, __ATOMIC_ACQUIRE); rd; rd = rd->next)
+	{
+		e = __atomic_load_n(&rd->epoch, __ATOMIC_ACQUIRE);
+		if (e && e < min) min = e;
+	}
+	__atomic_store_n(&var_epoch_safe, min, __ATOMIC_RELEASE);
+
+	return min;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add memory to retire list and free memory
+ * retired earlier, when no reader can see it anymore.
+ * Retired memory is freed with given function after all readers that
+ * could have seen it have left reading.
+ */
+static void _v_retire_to(struct var_retire **list, size_t *count, size_t *list_size, void *p, void (*f)(void *))
+{
+	struct var_retire *r;
+	unsigned long min;
+	size_t size, i, j;
+
+	if (!p) return;
+
+	if (*count >= *list_size)
+	{
+		size = *list_size ? *list_size * 2 : VAR_RETIRE_BATCH;
+		r = (struct var_retire *)realloc(*list, sizeof(*r) * size);
+		/* Without memory to remember this, it can only be leaked. */
+		if (!r) return;
+		*list = r;
+		*list_size = size;
+	}
+	r = &(*list)[(*count)++];
+	r->p = p;
+	r->f = f;
+	r->epoch = __atomic_load_n(&var_epoch, __ATOMIC_SEQ_CST);
+
+	if (*count % VAR_RETIRE_BATCH) return;
+
+	/* Free everything retired before oldest epoch being read. */
+	min = _v_epoch_min();
+	r = *list;
+	for (i = 0, j = 0; i < *count; i++)
+	{
+		if (r[i].epoch < min) r[i].f(r[i].p);
+		else r[j++] = r[i];
+	}
+	*count = j;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Free all memory in retire list right away.
+ * @note Only for var_quit(), when there must be no readers anymore.
+ */
+static void _v_retire_flush_to(struct var_retire **list, size_t *count, size_t *list_size)
+{
+	size_t i;
+
+	for (i = 0; i < *count; i++) (*list)[i].f((*list)[i].p);
+	if (*list) free(*list);
+	*list = NULL;
+	*count = 0;
+	*list_size = 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Retire memory that readers might still use.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_retire(struct var_list *l, void *p, void (*f)(void *))
+{
+	_v_retire_to(&l->retired, &l->retired_c, &l->retired_size, p, f);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Retire memory replaced by reader.
+ * @note Caller must be inside var_read_begin().
+ */
+static void _v_retire_local(void *p, void (*f)(void *))
+{
+	struct var_reader *r = var_reader;
+
+	_v_retire_to(&r->retired, &r->retired_c, &r->retired_size, p, f);
+}
+
+
+/******************************************************************************/
+int var_read_begin(void)
+{
+	struct var_reader *r = _v_reader();
+
+	if (!r) return -1;
+	if (r->nest++ == 0)
+	{
+		__atomic_store_n(&r->epoch, __atomic_load_n(&var_epoch, __ATOMIC_SEQ_CST), __ATOMIC_RELAXED);
+		/* Epoch must be visible before any list is read. */
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+void var_read_end(void)
+{
+	struct var_reader *r = var_reader;
+
+	if (!r || r->nest < 1) return;
+	if (--r->nest == 0) __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+}
+
+
 /******************************************************************************/
 /**
  * Internal help routine:
@@ -117,1357 +621,5430 @@ char *_v_trim_all(char *str)
 
 /******************************************************************************/
 /**
- * Internal help routine: Free variable item.
+ * Internal help routine: Allocate memory from list arena.
+ * Small allocations are carved from VAR_ARENA_BLOCK_SIZE sized blocks,
+ * larger ones get a block of their own. Memory is given back only when
+ * the whole arena is freed.
  * @note Wont lock var_list.
  */
-void _v_free(struct var_item *v)
+static void *_v_arena_alloc(struct var_list *l, size_t size)
 {
-	if (v)
+	struct var_arena_block *b = l->arena;
+	size_t bsize;
+	void *p;
+
+	size = (size + VAR_ARENA_ALIGN - 1) & ~((size_t)VAR_ARENA_ALIGN - 1);
+	if (!b || b->size - b->used < size)
 	{
-		if (v->data)
+		bsize = size > VAR_ARENA_BLOCK_SIZE / 4 ? size : VAR_ARENA_BLOCK_SIZE;
+		b = (struct var_arena_block *)malloc(sizeof(*b) + bsize);
+		if (!b) return NULL;
+		b->size = bsize;
+		b->used = 0;
+		/* Keep current block first if this one is dedicated to large data. */
+		if (bsize == size && l->arena)
 		{
-			free(v->data);
-			v->data = NULL;
-			v->size = 0;
-			v->type = VAR_TYPE_EMPTY;
+			b->next = l->arena->next;
+			l->arena->next = b;
+		}
+		else
+		{
+			b->next = l->arena;
+			l->arena = b;
 		}
 	}
+
+	p = b->data + b->used;
+	b->used += size;
+
+	return p;
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Set (and allocate) new data for item.
- * @note Wont lock var_list.
+ * Internal help routine: Free chain of arena memory blocks.
  */
-void _v_set(struct var_item *v, void *data, int size, int type)
+static void _v_arena_free(void *p)
 {
-	/* If more buffer needed, allocate it and free old. */
-	if (v->size < size)
+	struct var_arena_block *b = (struct var_arena_block *)p, *next;
+
+	for ( ; b; b = next)
 	{
-		_v_free(v);
-		v->data = malloc(size);
-		if (v->data) v->size = size;
-		else v->size = 0;
+		next = b->next;
+		free(b);
 	}
-	/* Copy new data and set type. */
-	v->type = type;
-	if (v->data) memcpy(v->data, data, size);
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Allocate new item in list.
- * @note Wont lock var_list.
+ * Internal help routine: Free number value and its string form.
  */
-void _v_new(struct var_item **v, var_list_t list, char *name)
+static void _v_num_free(void *p)
 {
-	*v = (struct var_item *)malloc(VAR_ITEM_SIZE);
-	if (*v)
-	{
-		memset(*v, 0, VAR_ITEM_SIZE);
-		if (name) STRCPY((*v)->key, name);
-		(*v)->type = VAR_TYPE_EMPTY;
-		if (!var_list[list].first)
-		{
-			var_list[list].first = *v;
-			var_list[list].last = *v;
-		}
-		else
-		{
-			var_list[list].last->next = *v;
-			var_list[list].last = *v;
-		}
-		var_list[list].count++;
-	}
+	struct var_num *n = (struct var_num *)p;
+
+	if (n->str) free(n->str);
+	free(n);
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Find variable.
- * @note Wont lock var_list.
- *
- * @param list List ID which to used in search.
- * @param name Name of variable to find.
- * @return Pointer to variable struct, or NULL.
+ * Internal help routine: Free string form of number in small buffer of
+ * item. Readers may format it any time while they can see the number,
+ * so it is freed only when small buffer is reused or item freed.
  */
-struct var_item *_v_find(var_list_t list, char *name)
+static void _v_small_num_free(struct var_item *v)
 {
-	struct var_item *v;
-	int i, n;
-	
-	/* Return error, if lib not initialized yet. */
-	if (!var_list) return NULL;
-	
-	/* Check search conditions. */
-	if (list < 0)
-	{
-		i = 0;
-		n = var_list_c;
-	}
-	else if (list < var_list_c)
-	{
-		i = list;
-		n = list + 1;
-	}
-	else return NULL;
+	struct var_num *n = (struct var_num *)v->small;
 
-	for ( ; i < n; i++)
-	{
-		for (v = var_list[i].first; v; v = (struct var_item *)v->next)
-		{
-			if (strcmp(v->key, name) == 0) return v;
-		}
-	}
-
-	return NULL;
-}
+	if (!(v->flags & VAR_ITEM_SMALL_NUM)) return;
+	if (n->str) free(n->str);
+	n->str = NULL;
+	__atomic_and_fetch(&v->flags, ~VAR_ITEM_SMALL_NUM, __ATOMIC_RELAXED);
+}
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Set variable data to given.
- * @note Lock's var_list when needed.
+ * Internal help routine: Check whether small buffer of item can be used
+ * for new value. Buffer that had old value can be used again only after
+ * all readers that could have seen the old value have left reading.
+ * @note Caller must hold write lock of list.
  *
- * @param list ID of list to be used.
- * @param name Name of item to be set.
- * @param data Pointer to data to be set.
- * @param size Size of data.
- * @param type Type of data to be set.
- * @return Returns 0 on success, -1 on errors.
+ * @return 1 if buffer can be used, 0 if not.
  */
-int _v_list_set(var_list_t list, const char *name, void *data, int size, int type)
+static int _v_small_unused(struct var_item *v)
 {
-	int i, n, create, err;
-	struct var_item *v;
-	char *name_real = (char *)name;
-	
-	/* Return error, if lib not initialized yet. */
-	if (!var_list) return -1;
-	/* Return error, if name is invalid. */
-	if (!name) return -1;
+	if (v->data == v->small) return 0;
+	if (v->small_epoch && v->small_epoch >= __atomic_load_n(&var_epoch_safe, __ATOMIC_ACQUIRE) &&
+	    v->small_epoch >= _v_epoch_min()) return 0;
+	_v_small_num_free(v);
+	return 1;
+}
 
-	lock_write(&var_list_lock);
 
-	/* Check search conditions. */
-	if (list < 0)
-	{
-		i = 0;
-		n = var_list_c;
-		create = 0;
-	}
-	else if (list < var_list_c)
-	{
-		i = list;
-		n = list + 1;
-		create = 1;
-	}
-	else
-	{
-		err = -1;
-		goto out_err;
-	}
+/******************************************************************************/
+/**
+ * Internal help routine: Retire value of item.
+ * Number values are never allocated from arena, since their string form
+ * is allocated later by readers. Value in small buffer of item is not
+ * retired, see _v_small_unused().
+ * @note Caller must hold write lock of list.
+ */
+static void _v_retire_data(struct var_list *l, struct var_item *v, int type, void *data)
+{
+	if (!data || data == v->small) return;
+	if (VAR_TYPE_IS_NUM(type)) _v_retire(l, data, _v_num_free);
+	else if (!(v->flags & VAR_ITEM_ARENA)) _v_retire(l, data, free);
+}
 
-	/* if name is null, autogenerate it */
-	while (!name && list > 0 && list < var_list_c)
-	{
-		asprintf(&name_real, "%d", var_list[list].auto_array_counter);
-		v = _v_find(list, name_real);
-		var_list[list].auto_array_counter++;
-		if (!v) break;
-	}
 
-	/* Go trough requested item(s). */
-	for ( ; i < n; i++)
-	{
-		/* Try to find item from list. */
-		v = _v_find(i, name_real);
+/******************************************************************************/
+/**
+ * Internal help routine: Free removed item and its memo.
+ * Readers may have stored memo to item after it was removed.
+ */
+static void _v_item_free(void *p)
+{
+	struct var_item *v = (struct var_item *)p;
 
-		/* Create new item, if needed. */
-		if (!v && create) _v_new(&v, i, name_real);
-		
-		/* Setup new data, if item found/created. */
-		if (v) _v_set(v, data, size, type);
-	}
+	if (v->memo) free(v->memo);
+	_v_small_num_free(v);
+	free(v);
+}
 
-	err = 0;
 
-out_err:
-	if (!name && name_real) free(name_real);
-	lock_unlock(&var_list_lock);
-	return err;
+/******************************************************************************/
+/**
+ * Internal help routine: Free memo of removed arena item.
+ * Item itself is freed with the arena.
+ */
+static void _v_item_arena_free(void *p)
+{
+	struct var_item *v = (struct var_item *)p;
+
+	if (v->memo) free(v->memo);
+	v->memo = NULL;
+	_v_small_num_free(v);
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Add string after string.
+ * Internal help routine: Free variable item.
+ * Data of arena items is only forgotten, it is freed with the arena.
+ * Small value is freed with item.
  * @note Wont lock var_list.
- *
- * @param dst Destination string.
- *            Reallocates space here, if needed.
- *            Can be NULL.
- * @param size Size of destination buffer. Stores new size here also.
- * @param src Source string.
- * @param max Maximum characters to be copied, or -1 for no maximum.
  */
-void _v_strcat(char **dst, int *size, const char *src, int max)
+void _v_free(struct var_item *v)
 {
-	int n;
-	
-	/* Just check couple things first for sure. */
-	if (!src || max == 0) return;
-	if (src[0] == '\0') return;
-
-	/* Get length of source and check if new space is needed. */
-	n = strlen(src) + 1; /* +1 includes null char. */
-	if (n > *size || !*dst)
-	{
-		/* Clear these, if either is not valid according to other. */
-		if (!*dst) *size = 0;
-		else if (*size < 1) *dst = NULL;
-		
-		/* Allocate VAR_MIN_MALLOC multiples of new space. */
-		n = *size + VAR_MIN_MALLOC * (1 + (int)(n / VAR_MIN_MALLOC));
-		*dst = realloc(*dst, n);
-		if (!*dst) *size = 0;
-		else
+	if (v)
+	{
+		if (v->data)
 		{
-			memset(&((*dst)[*size]), 0, n - *size);
-			*size = n;
+			if (v->data == v->small);
+			else if (VAR_TYPE_IS_NUM(v->type)) _v_num_free(v->data);
+			else if (!(v->flags & VAR_ITEM_ARENA)) free(v->data);
+			v->data = NULL;
+			v->size = 0;
+			v->type = VAR_TYPE_EMPTY;
 		}
 	}
-	
-	/* Append source to destination. */
-	if (max > 0) strncat(*dst, src, max);
-	else strcat(*dst, src);
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Parse variable into buffer.
- * @note Wont lock var_list.
+ * Internal help routine: Allocate prefix tree node with given label.
  */
-char *_v_parse(struct var_item *v, struct var_list *recursion, int *lists, int lc)
+static struct var_trie *_v_trie_node(const char *label, size_t len)
 {
-	int i, j, n = 0;
-	char *result = NULL, *res, *var, *varprev, *subvar;
-	struct var_item *subv, node, *prevnode = NULL;
-	
-	/* Check that type is supported in this function. */
-	switch (v->type)
-	{
-	case VAR_TYPE_STR:
-	case VAR_TYPE_NUM:
-		break;
-	default:
-		return var_empty_string;
-	}
+	struct var_trie *t;
 
-	/*
-	 * Check that this node is not already visited previously on
-	 * lower level. If this check is not done, we could end up in
-	 * dead lock, adding contents of variables inside each other.
-	 */
-	for (prevnode = recursion->first; prevnode; prevnode = prevnode->next)
-	{
-		if (prevnode->data == v) return var_empty_string;
-	}
-	prevnode = NULL;
+	t = (struct var_trie *)malloc(sizeof(*t) + len);
+	if (!t) return NULL;
+	memset(t, 0, sizeof(*t));
+	memcpy(t->label, label, len);
+	t->len = len;
 
-	/* Add current item to recursion stack. */
-	node.data = v;
-	node.next = NULL;
-	if (!recursion->first)
-	{
-		recursion->first = &node;
-		recursion->last = &node;
-	}
-	else
-	{
-		recursion->last->next = &node;
-		prevnode = recursion->last;
-		recursion->last = &node;
-	}
-	recursion->count++;
+	return t;
+}
 
-	/*
-	 * Parse variable content.
-	 * This mostly means converting $<variable name> to their contents.
-	 */
-	var = (char *)v->data;
-	n = 0;
-	result = NULL;
-	for ( ; ; )
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add item to prefix tree.
+ * Node is split when key ends or differs in the middle of its label.
+ * @note Caller must hold write lock of list.
+ *
+ * @param slot First node of tree.
+ * @param key Key of item.
+ * @param v Item.
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_trie_add(struct var_trie **slot, const char *key, struct var_item *v)
+{
+	struct var_trie *t, *split;
+	size_t i;
+
+	while (*key)
 	{
-		varprev = var;
-		var = strpbrk(var, VAR_CHARS);
-		
-		if (!var)
+		for ( ; *slot && (*slot)->label[0] != *key; slot = &(*slot)->next);
+		t = *slot;
+		if (!t)
 		{
-			_v_strcat(&result, &n, varprev, -1);
-			break;
+			t = _v_trie_node(key, strlen(key));
+			if (!t) return -1;
+			t->item = v;
+			*slot = t;
+			return 0;
 		}
-		
-		_v_strcat(&result, &n, varprev, (int)(var - varprev));
 
-		if (strchr(VAR_SPECIAL, (int)var[1]))
-		{
-			_v_strcat(&result, &n, &var[1], 1);
-			var += 2;
-			continue;
-		}
-		
-		i = sscanf(&var[1], "%a[^" VAR_BREAK "]", &res);
-		if (i == 1)
+		for (i = 1; i < t->len && key[i] == t->label[i]; i++);
+		if (i < t->len)
 		{
-			var++;
-			subv = NULL;
-			for (j = 0; j < lc && !subv; j++) subv = _v_find(lists[j], res);
-			if (!subv) subvar = var_empty_string;
-			else subvar = _v_parse(subv, recursion, lists, lc);
-			_v_strcat(&result, &n, subvar, -1);
-			var += strlen(res);
-			if (strchr(VAR_CHARS, (int)*var)) var++;
-			var_free(subvar);
-			free(res);
+			split = _v_trie_node(t->label, i);
+			if (!split) return -1;
+			split->next = t->next;
+			split->child = t;
+			t->next = NULL;
+			memmove(t->label, t->label + i, t->len - i);
+			t->len -= i;
+			*slot = split;
+			t = split;
 		}
-		else var++;
-	}
 
-	/* Remove us from the recursion stack. */
-	if (recursion->count > 0)
-	{
-		recursion->last = prevnode;
-		if (prevnode) recursion->last->next = NULL;
-		recursion->count--;
+		key += i;
+		if (!*key) t->item = v;
+		slot = &t->child;
 	}
 
-	/* Return result. */
-	if (!result) result = var_empty_string;
-	return result;
+	return 0;
 }
 
 
 /******************************************************************************/
 /**
- * Internal help routine: Find best match for keystr from variables.
- * @note Wont lock var_list.
+ * Internal help routine: Remove item from prefix tree.
+ * Nodes left without item are freed or merged to their only child.
+ * @note Caller must hold write lock of list.
  *
- * @param list List ID which to used in search.
- * @param keystr String which to try match variables name.
- * @return Pointer to variable struct, or NULL.
+ * @param slot First node of tree.
+ * @param key Key of item.
  */
-struct var_item *_v_find_best(var_list_t list, char *keystr)
+static void _v_trie_rm(struct var_trie **slot, const char *key)
 {
-	struct var_item *v, *vret = NULL;
-	int i, n, len;
-	
-	/* Return error, if lib not initialized yet. */
-	if (!var_list) return NULL;
-	
-	/* Check search conditions. */
-	if (list < 0)
-	{
-		i = 0;
-		n = var_list_c;
-	}
-	else if (list < var_list_c)
+	struct var_trie *t, *c, *m;
+
+	for ( ; *slot && (*slot)->label[0] != *key; slot = &(*slot)->next);
+	t = *slot;
+	if (!t || strncmp(t->label, key, t->len) != 0) return;
+
+	key += t->len;
+	if (*key) _v_trie_rm(&t->child, key);
+	else t->item = NULL;
+	if (t->item) return;
+
+	c = t->child;
+	if (!c)
 	{
-		i = list;
-		n = list + 1;
+		*slot = t->next;
+		free(t);
 	}
-	else return NULL;
-
-	for (len = 0; i < n; i++)
+	else if (!c->next)
 	{
-		for (v = var_list[i].first; v; v = (struct var_item *)v->next)
-		{
-			int l = strlen(v->key);
-			if (strncmp(v->key, keystr, l) == 0 && l > len)
-			{
-				vret = v;
-			}
-		}
+		m = (struct var_trie *)realloc(t, sizeof(*t) + t->len + c->len);
+		if (!m) return;
+		memcpy(m->label + m->len, c->label, c->len);
+		m->len += c->len;
+		m->child = c->child;
+		m->item = c->item;
+		*slot = m;
+		free(c);
 	}
-
-	return vret;
 }
 
 
 /******************************************************************************/
 /**
- * Initialize variable library.
- * Returns 0 also, if init function already called.
- *
- * @return 0 on success, -1 on errors.
+ * Internal help routine: Free prefix tree.
  */
-int var_init(void)
+static void _v_trie_free(struct var_trie *t)
 {
-	/* Dont init, if already init. */
-	if (var_list) return 0;
-
-	/* Allocate default list. */
-	var_list_c = 0;
-	var_list = (struct var_list *)malloc(VAR_LIST_SIZE);
-	if (!var_list) return -1;
-	memset(&var_list[var_list_c], 0, VAR_LIST_SIZE);
-	var_list_c = 1;
-	
-	if (lock_init(&var_list_lock))
+	struct var_trie *next;
+
+	for ( ; t; t = next)
 	{
-		free(var_list);
-		var_list_c = 0;
-		return -1;
+		next = t->next;
+		_v_trie_free(t->child);
+		free(t);
 	}
-	
-	return 0;
 }
 
 
 /******************************************************************************/
-/** Quit using this library. */
-void var_quit(void)
+/**
+ * Internal help routine: Free layer and all items in it.
+ */
+static void _v_layer_free(void *p)
 {
-	struct var_item *v, *v2;
-	int i;
-
-	/* Return, if lib not initialized yet. */
-	if (!var_list) return;
-	
-	lock_write(&var_list_lock);
+	struct var_layer *layer = (struct var_layer *)p;
+	struct var_item *v, *next;
 
-	for (i = 0; i < var_list_c; i++)
+	/* Items in snapshot only have memory allocated by readers. */
+	if (layer->image)
 	{
-		for (v = var_list[i].first; v; )
+		for (v = layer->first; v; v = v->next)
+		{
+			if (v->memo) free(v->memo);
+			if (VAR_TYPE_IS_NUM(v->type) && ((struct var_num *)v->data)->str) free(((struct var_num *)v->data)->str);
+		}
+		if (__atomic_sub_fetch(&layer->image->refs, 1, __ATOMIC_ACQ_REL) == 0)
 		{
-			v2 = v;
-			v = (struct var_item *)v->next;
-			_v_free(v2);
-			free(v2);
+			munmap(layer->image->map, layer->image->size);
+			free(layer->image);
 		}
+		free(layer);
+		return;
 	}
-	
-	if (var_list) free(var_list);
-	var_list = NULL;
-	var_list_c = 0;
-	
-	lock_destroy(&var_list_lock);
+
+	for (v = layer->first; v; v = next)
+	{
+		next = v->next;
+		_v_free(v);
+		if (v->flags & VAR_ITEM_ARENA) _v_item_arena_free(v);
+		else _v_item_free(v);
+	}
+	if (layer->hash) free(layer->hash);
+	_v_trie_free(layer->trie);
+	_v_arena_free(layer->arena);
+	free(layer);
 }
 
 
 /******************************************************************************/
-/** Dump debug info about contents of lists and their variables. */
-void var_dump(void)
+/**
+ * Internal help routine: Release reference to layer. Layer is retired
+ * when last list using it releases it, which then releases its base.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_layer_put(struct var_list *l, struct var_layer *layer)
 {
-	struct var_item *v;
-	int i, j;
-	char *type, content[MAX_STRING];
+	struct var_layer *base;
 
-	/* Return, if lib not initialized yet. */
-	if (!var_list)
-	{
-		printf("library is empty\n");
-		return;
-	}
-	
-	for (i = 0; i < var_list_c; i++)
+	for ( ; layer && __atomic_sub_fetch(&layer->refs, 1, __ATOMIC_ACQ_REL) == 0; layer = base)
 	{
-		printf("** %d. printing items in list (name \'%s\', item count %d)\n", (int)i, var_list[i].name, (int)var_list[i].count);
-		for (j = 0, v = var_list[i].first; v; v = (struct var_item *)v->next, j++)
-		{
-			switch (v->type)
-			{
-			case VAR_TYPE_EMPTY:
-				type = "empty";
-				break;
-			case VAR_TYPE_STR:
-				type = "ascii";
-				break;
-			case VAR_TYPE_NUM:
-				type = "number";
-				break;
-			case VAR_TYPE_BIN:
-				type = "binary";
-				break;
-			}
-			
-			memset(content, 0, sizeof(content));
-			strncpy(content, v->data, 20);
-			if (strlen(v->data) > strlen(content)) strcat(content, "...");
-			printf("    %d. name \'%s\', type \'%s\', size %d, content \'%s\'\n", (int)j, v->key, type, (int)v->size, content);
-		}
+		/* Layer can be freed right when retired, if there are no readers. */
+		base = layer->base;
+		_v_retire(l, layer, _v_layer_free);
 	}
 }
 
 
 /******************************************************************************/
 /**
- * Allocate new item in variables.
- * @param name Optional name for new variable list. Can be NULL.
- * @return Index of new list or -1 on errors.
+ * Internal help routine: Make hash from variable name.
  */
-var_list_t varl_new(char *name)
+static inline unsigned int _v_hash(const char *str)
 {
-	int size, err;
-	var_list_t list = -1;
-	
-	/* Return error, if lib not initialized yet. */
-	if (!var_list) return -1;
+	unsigned int hash = 0;
+	int c;
 
-	/* check for existing list with this name */
-	list = varl_find(name);
-	if (list > -1) return list;
-	
-	lock_write(&var_list_lock);
-	
-	/* Re-alloc space for new item. */
-	size = VAR_LIST_SIZE * (var_list_c + 1);
-	var_list = (struct var_list *)realloc(var_list, size);
-	if (!var_list)
-	{
-		err = -1;
-		goto out_err;
-	}
-	
-	/* Setup new item. */
-	memset(&var_list[var_list_c], 0, VAR_LIST_SIZE);
-	if (name) STRCPY(var_list[var_list_c].name, name);
-	var_list_c++;
-	
-	list = (var_list_c - 1);
+	while ((c = (unsigned char)*str++)) hash = c + (hash << 6) + (hash << 16) - hash;
 
-out_err:
-	lock_unlock(&var_list_lock);
-	return list;
+	return hash;
 }
 
 
 /******************************************************************************/
 /**
- * Find variable list with its name. This function can be used to find only
- * named lists. If named list is not found, default list 0 is returned.
- * Default list has no name, so either caller can use returned group number
- * without caring whether right list is found or detect unfound list from
- * return value 0.
+ * Internal help routine: Scan string for references to variables.
+ * Called first without template to count tokens and size needed, then
+ * with template which has count set to fill in the tokens. Text tokens
+ * point to given string, names of references are copied after tokens.
+ * @note Syntax is same as in earlier parser: $name ends to any of
+ *       VAR_BREAK, $ right after name is skipped and $$ is plain $.
  *
- * @param name Name of list given when calling varl_new().
- * @return Index of item found or -1 if not found.
+ * @param str String to scan.
+ * @param len Length of string.
+ * @param t Template to fill, or NULL to count.
+ * @param count Where to store count of tokens.
+ * @return Size of template, 0 if string has no variables.
  */
-var_list_t varl_find(char *name)
+static size_t _v_tmpl_scan(const char *str, size_t len, struct var_tmpl *t, size_t *count)
 {
-	var_list_t i;
-	
-	/* Return error, if lib not initialized yet. */
-	if (!var_list) return -1;
-	/* Return first list, if no name is given. */
-	if (!name) return -1;
-	if (strlen(name) < 1) return 0;
-	
-	lock_read(&var_list_lock);
-	
-	/* Find list. */
-	for (i = 0; i < var_list_c; i++)
+	const char *p = str, *q, *end = str + len;
+	char *names = t ? (char *)&t->tok[t->count] : NULL;
+	size_t n, bytes = 0;
+	int found = 0;
+
+	*count = 0;
+	for (q = p; q < end; )
+	{
+		if (!strchr(VAR_CHARS, *q))
+		{
+			q++;
+			continue;
+		}
+		found = 1;
+
+		/* Text before variable. */
+		if (q > p)
+		{
+			if (t) t->tok[*count] = (struct var_tmpl_tok){ .str = p, .len = q - p };
+			(*count)++;
+		}
+		p = ++q;
+		if (q >= end) break;
+
+		if (strchr(VAR_SPECIAL, *q))
+		{
+			if (t) t->tok[*count] = (struct var_tmpl_tok){ .str = q, .len = 1 };
+			(*count)++;
+			p = ++q;
+			continue;
+		}
+
+		for (n = 0; q + n < end && !strchr(VAR_BREAK, q[n]); n++);
+		if (n < 1) continue;
+		if (t)
+		{
+			memcpy(&names[bytes], q, n);
+			names[bytes + n] = '\0';
+			t->tok[*count] = (struct var_tmpl_tok){ .str = &names[bytes], .len = n, .ref = 1, .cache_list = -2 };
+			t->tok[*count].hash = _v_hash(&names[bytes]);
+		}
+		(*count)++;
+		bytes += n + 1;
+		q += n;
+		if (q < end && strchr(VAR_CHARS, *q)) q++;
+		p = q;
+	}
+	if (!found) return 0;
+
+	/* Text after last variable. */
+	if (end > p)
+	{
+		if (t) t->tok[*count] = (struct var_tmpl_tok){ .str = p, .len = end - p };
+		(*count)++;
+	}
+
+	return sizeof(*t) + sizeof(t->tok[0]) * (*count) + bytes;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set (and allocate) new data for item.
+ * Readers might be using old data, so new data always gets a new buffer
+ * and old one is retired. Buffer is always null terminated.
+ * Small values are stored in item itself, when its small buffer is not
+ * in use, see _v_small_unused().
+ * Strings with variables are compiled to template, which is stored in
+ * the same buffer after the string. String without terminator within
+ * given size is stored with one, so strings can be set from the middle
+ * of larger buffer.
+ * Old data is kept, if allocating new buffer fails.
+ * @note Caller must hold write lock of list.
+ *
+ * @param own If set, data was allocated with malloc() and is given to
+ *            item. It is used as new buffer when possible, and freed
+ *            otherwise, also on errors.
+ */
+static void _v_set_data(struct var_list *l, struct var_item *v, void *data, int size, int type, int own)
+{
+	void *old = v->data, *p;
+	struct var_tmpl *tmpl = NULL;
+	size_t n, len = 0, tn = 0, count, copy = size;
+	int old_type = v->type;
+
+	if (type == VAR_TYPE_STR)
+	{
+		len = strnlen(data, size);
+		if (len == copy) size++;
+		tn = _v_tmpl_scan(data, len, NULL, &count);
+	}
+	n = size + 1;
+	if (tn) n = ((n + VAR_ARENA_ALIGN - 1) & ~((size_t)VAR_ARENA_ALIGN - 1)) + tn;
+
+	if (own && n > VAR_ITEM_SMALL && !((v->flags & VAR_ITEM_ARENA) && !VAR_TYPE_IS_NUM(type)))
+	{
+		/* Given buffer is used as is, if it is already terminated. */
+		if (!tn && copy > 0 && !((char *)data)[copy - 1]) n = copy;
+		else if (!(p = realloc(data, n)))
+		{
+			free(data);
+			return;
+		}
+		else data = p;
+		p = data;
+	}
+	else
+	{
+		if (n <= VAR_ITEM_SMALL && _v_small_unused(v)) p = v->small;
+		else if ((v->flags & VAR_ITEM_ARENA) && !VAR_TYPE_IS_NUM(type)) p = _v_arena_alloc(l, n);
+		else p = malloc(n);
+		if (p) memcpy(p, data, copy);
+		if (own) free(data);
+		if (!p) return;
+	}
+	if (n > copy)
+	{
+		((char *)p)[copy] = '\0';
+		((char *)p)[size] = '\0';
+	}
+
+	if (tn)
+	{
+		tmpl = (struct var_tmpl *)((char *)p + n - tn);
+		tmpl->count = count;
+		_v_tmpl_scan(p, len, tmpl, &count);
+	}
+
+	/* Sequence is odd while type, data and size do not match. */
+	__atomic_store_n(&v->seq, v->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&v->size, size, __ATOMIC_RELAXED);
+	__atomic_store_n(&v->data, p, __ATOMIC_RELAXED);
+	__atomic_store_n(&v->type, type, __ATOMIC_RELAXED);
+	__atomic_store_n(&v->tmpl, tmpl, __ATOMIC_RELAXED);
+	__atomic_store_n(&v->seq, v->seq + 1, __ATOMIC_RELEASE);
+
+	if (p == v->small && VAR_TYPE_IS_NUM(type)) __atomic_or_fetch(&v->flags, VAR_ITEM_SMALL_NUM, __ATOMIC_RELAXED);
+	if (old == v->small) v->small_epoch = __atomic_load_n(&var_epoch, __ATOMIC_SEQ_CST);
+	_v_retire_data(l, v, old_type, old);
+	/* Memo would be found invalid anyway, but free it sooner. */
+	_v_retire(l, __atomic_exchange_n(&v->memo, NULL, __ATOMIC_ACQ_REL), free);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set new data for item, see _v_set_data().
+ * @note Caller must hold write lock of list.
+ */
+void _v_set(struct var_list *l, struct var_item *v, void *data, int size, int type)
+{
+	_v_set_data(l, v, data, size, type, 0);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Load item type, data, template and sequence
+ * for lock-free reading. Sequence changes whenever value is set.
+ * @note Caller must be inside var_read_begin() or hold lock of list.
+ *
+ * @return Type of item.
+ */
+static inline int _v_get_tmpl(struct var_item *v, void **data, size_t *size, struct var_tmpl **tmpl, unsigned int *vseq)
+{
+	struct var_tmpl *t;
+	unsigned int seq;
+	size_t n;
+	int type;
+
+	do
+	{
+		while ((seq = __atomic_load_n(&v->seq, __ATOMIC_ACQUIRE)) & 1);
+		type = __atomic_load_n(&v->type, __ATOMIC_RELAXED);
+		*data = __atomic_load_n(&v->data, __ATOMIC_RELAXED);
+		n = __atomic_load_n(&v->size, __ATOMIC_RELAXED);
+		t = __atomic_load_n(&v->tmpl, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (seq != __atomic_load_n(&v->seq, __ATOMIC_RELAXED));
+
+	if (size) *size = n;
+	if (tmpl) *tmpl = t;
+	if (vseq) *vseq = seq;
+	if (!*data) return VAR_TYPE_EMPTY;
+
+	return type;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Load item type and data for lock-free reading.
+ * @note Caller must be inside var_read_begin() or hold lock of list.
+ *
+ * @return Type of item.
+ */
+static inline int _v_get(struct var_item *v, void **data, size_t *size)
+{
+	return _v_get_tmpl(v, data, size, NULL, NULL);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get string form of value.
+ * String form of numbers is formatted when first asked and then kept
+ * with the number, until the value changes.
+ * @note Caller must be inside var_read_begin() or hold lock of list.
+ *
+ * @param type Type of value, from _v_get().
+ * @param data Value, from _v_get().
+ * @return String, or NULL if value has no string form.
+ */
+static char *_v_str(int type, void *data)
+{
+	struct var_num *n = (struct var_num *)data;
+	char *str, *old = NULL;
+	int err;
+
+	if (type == VAR_TYPE_STR) return (char *)data;
+	if (!VAR_TYPE_IS_NUM(type)) return NULL;
+
+	str = __atomic_load_n(&n->str, __ATOMIC_ACQUIRE);
+	if (str) return str;
+
+	if (type == VAR_TYPE_INT) err = asprintf(&str, "%d", n->i);
+	else err = asprintf(&str, "%lf", n->num);
+	if (err < 0) return NULL;
+
+	/* Other reader might have been faster. */
+	if (!__atomic_compare_exchange_n(&n->str, &old, str, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+	{
+		free(str);
+		str = old;
+	}
+
+	return str;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Replace hash index of list.
+ * Readers may be walking the chains being changed, so hash_seq is odd
+ * while changing and readers retry when it changes under them.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_hash_publish(struct var_list *l, struct var_item **hash, size_t size)
+{
+	struct var_item **old = l->hash, *v;
+
+	__atomic_store_n(&l->hash_seq, l->hash_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	for (v = l->first; v && hash; v = v->next)
+	{
+		__atomic_store_n(&v->hash_next, hash[v->hash & (size - 1)], __ATOMIC_RELAXED);
+		hash[v->hash & (size - 1)] = v;
+	}
+
+	/* Pointer is published before size, so size read first always fits. */
+	__atomic_store_n(&l->hash, hash, __ATOMIC_RELEASE);
+	__atomic_store_n(&l->hash_size, size, __ATOMIC_RELEASE);
+	__atomic_store_n(&l->hash_seq, l->hash_seq + 1, __ATOMIC_RELEASE);
+
+	_v_retire(l, old, free);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Grow hash index of list and rehash all items.
+ * Index is at least doubled, and grown at once to fit given count.
+ * @note Caller must hold write lock of list.
+ *
+ * @param count Number of items index must have room for.
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_hash_grow(struct var_list *l, size_t count)
+{
+	struct var_item **hash;
+	size_t size;
+
+	size = l->hash_size ? l->hash_size * 2 : VAR_HASH_MIN_SIZE;
+	while (size < count) size *= 2;
+	hash = (struct var_item **)malloc(sizeof(*hash) * size);
+	if (!hash) return -1;
+	memset(hash, 0, sizeof(*hash) * size);
+
+	_v_hash_publish(l, hash, size);
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable from hash index.
+ * @note Caller must be inside var_read_begin() or hold lock of list.
+ */
+static inline struct var_item *_v_find_table(struct var_item **table, size_t size, const char *name, unsigned int hash)
+{
+	struct var_item *v;
+
+	if (!table || size < 1) return NULL;
+	v = __atomic_load_n(&table[hash & (size - 1)], __ATOMIC_ACQUIRE);
+	for ( ; v; v = __atomic_load_n(&v->hash_next, __ATOMIC_ACQUIRE))
+	{
+#ifdef VAR_STATS
+		var_stat_scanned++;
+#endif
+		if (v->hash == hash && strcmp(v->key, name) == 0) return v;
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable from layers, newest layer first.
+ * @note Caller must be inside var_read_begin() or hold lock of list.
+ *
+ * @return Pointer to variable struct, or NULL if not found or deleted.
+ */
+static struct var_item *_v_find_layer(struct var_layer *layer, const char *name, unsigned int hash)
+{
+	struct var_item *v;
+
+	for ( ; layer; layer = layer->base)
+	{
+		v = _v_find_table(layer->hash, layer->hash_size, name, hash);
+		if (v) return (v->flags & VAR_ITEM_DELETED) ? NULL : v;
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable from list itself, not from its
+ * base. Deleted items are returned too.
+ * @note Caller must hold write lock of list.
+ */
+static inline struct var_item *_v_find_own(struct var_list *l, const char *name, unsigned int hash)
+{
+	return _v_find_table(l->hash, l->hash_size, name, hash);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether item is hidden by item with same
+ * name in list itself or in layer newer than the one item is in.
+ * @note Caller must hold lock of list.
+ *
+ * @param layer Layer of item, NULL if item is in list itself.
+ */
+static int _v_hidden(struct var_list *l, struct var_layer *layer, struct var_item *v)
+{
+	struct var_layer *up;
+
+	if (v->flags & VAR_ITEM_DELETED) return 1;
+	if (!layer) return 0;
+	if (_v_find_own(l, v->key, v->hash)) return 1;
+	for (up = l->base; up != layer; up = up->base)
+	{
+		if (_v_find_table(up->hash, up->hash_size, v->key, v->hash)) return 1;
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get next item visible in list. Items in base of
+ * list are given first, oldest layer first, so items not set after list
+ * was copied keep their order.
+ * @note Caller must hold lock of list.
+ *
+ * @param layer Layer of given item, NULL if item is in list itself.
+ *              Set to layer of returned item.
+ * @param v Current item, or NULL to get first item.
+ * @return Next item, or NULL if there are no more items.
+ */
+static struct var_item *_v_next(struct var_list *l, struct var_layer **layer, struct var_item *v)
+{
+	struct var_layer *up;
+
+	if (!v)
+	{
+		for (*layer = l->base; *layer && (*layer)->base; *layer = (*layer)->base);
+		v = *layer ? (*layer)->first : l->first;
+	}
+	else v = v->next;
+
+	for (;;)
+	{
+		for ( ; v; v = v->next)
+		{
+			if (!_v_hidden(l, *layer, v)) return v;
+		}
+		if (!*layer) return NULL;
+
+		/* Continue from next newer layer. */
+		if (*layer == l->base) up = NULL;
+		else for (up = l->base; up->base != *layer; up = up->base);
+		*layer = up;
+		v = up ? up->first : l->first;
+	}
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get index from name of item.
+ * Only names written as index would be, without sign or leading zeros,
+ * are accepted, so each index has only one name.
+ *
+ * @return Index, or -1 if name is not index.
+ */
+static int _v_index(const char *key)
+{
+	long index = 0;
+
+	if (key[0] < '0' || key[0] > '9' || (key[0] == '0' && key[1])) return -1;
+	for ( ; *key >= '0' && *key <= '9'; key++)
+	{
+		index = index * 10 + (*key - '0');
+		if (index > INT_MAX) return -1;
+	}
+
+	return *key ? -1 : (int)index;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Write name of item with given index.
+ *
+ * @param key Buffer for name, at least 12 characters.
+ */
+static void _v_index_key(char *key, int index)
+{
+	char tmp[12];
+	int n = 0;
+
+	do
+	{
+		tmp[n++] = '0' + index % 10;
+		index /= 10;
+	} while (index > 0);
+	while (n > 0) *key++ = tmp[--n];
+	*key = '\0';
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Update item in array of list created with
+ * VAR_LIST_ARRAY, after item named with index was made visible or hidden.
+ * Array is grown to fit index, unless index is far past end of array.
+ * Items that do not fit are still found by name.
+ * @note Caller must hold write lock of list.
+ *
+ * @param visible 1 if item is now visible with its name, 0 if not.
+ */
+static void _v_slot_update(struct var_list *l, struct var_item *v, int visible)
+{
+	struct var_item **slot, **old = l->slot;
+	size_t size;
+	int index;
+
+	if (!(l->flags & VAR_LIST_ARRAY)) return;
+	index = _v_index(v->key);
+	if (index < 0) return;
+	if (!visible)
+	{
+		if ((size_t)index < l->slot_size) __atomic_store_n(&l->slot[index], NULL, __ATOMIC_RELEASE);
+		return;
+	}
+	if ((size_t)index >= l->slot_c) l->slot_c = (size_t)index + 1;
+
+	if ((size_t)index >= l->slot_size)
+	{
+		size = l->slot_size ? l->slot_size : VAR_HASH_MIN_SIZE;
+		while (size <= (size_t)index) size *= 2;
+		if (size > l->slot_size * 4 && size > VAR_HASH_MIN_SIZE * 4) return;
+		slot = (struct var_item **)malloc(sizeof(*slot) * size);
+		if (!slot) return;
+		if (l->slot_size) memcpy(slot, old, sizeof(*slot) * l->slot_size);
+		memset(&slot[l->slot_size], 0, sizeof(*slot) * (size - l->slot_size));
+		/* Pointer is published before size, so size read first always fits. */
+		__atomic_store_n(&l->slot, slot, __ATOMIC_RELEASE);
+		__atomic_store_n(&l->slot_size, size, __ATOMIC_RELEASE);
+		_v_retire(l, old, free);
+	}
+	__atomic_store_n(&l->slot[index], v, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Release array of list.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_slot_clear(struct var_list *l)
+{
+	struct var_item **old = l->slot;
+
+	__atomic_store_n(&l->slot_size, 0, __ATOMIC_RELEASE);
+	__atomic_store_n(&l->slot, NULL, __ATOMIC_RELEASE);
+	l->slot_c = 0;
+	_v_retire(l, old, free);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Put all items visible in list to its array.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_slot_list(struct var_list *l)
+{
+	struct var_layer *layer;
+	struct var_item *v;
+
+	if (!(l->flags & VAR_LIST_ARRAY)) return;
+	for (v = _v_next(l, &layer, NULL); v; v = _v_next(l, &layer, v)) _v_slot_update(l, v, 1);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Tell that many items were added or removed at
+ * once, which invalidates all cached lookups.
+ * Thread-local overlays are not cached, so changing them does not
+ * invalidate caches of other threads.
+ */
+static inline void _v_changed(struct var_list *l)
+{
+	if (!(l->flags & VAR_LIST_LOCAL)) __atomic_add_fetch(&var_items_version, 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Tell that item with given key was added, removed,
+ * hidden or shown again. Only cached lookups of keys in same slot are
+ * invalidated. Must be told before item is retired.
+ */
+static inline void _v_key_changed(struct var_list *l, unsigned int hash)
+{
+	if (!(l->flags & VAR_LIST_LOCAL)) __atomic_add_fetch(&var_key_versions[hash & (VAR_KEY_VERSIONS - 1)], 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get count of changes to items with key of slot.
+ * Version must be taken before looking up the key.
+ */
+static inline unsigned int _v_key_version(unsigned int hash)
+{
+	return __atomic_load_n(&var_key_versions[hash & (VAR_KEY_VERSIONS - 1)], __ATOMIC_ACQUIRE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Allocate new item with given flags in list.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_new_flags(struct var_list *l, struct var_item **v, const char *name, unsigned int flags)
+{
+	struct var_item **slot;
+	size_t len = name ? strlen(name) : 0;
+
+	if (l->flags & VAR_LIST_ARENA) *v = (struct var_item *)_v_arena_alloc(l, VAR_ITEM_ALLOC(len));
+	else *v = (struct var_item *)malloc(VAR_ITEM_ALLOC(len));
+	if (!*v) return;
+	memset(*v, 0, VAR_ITEM_SIZE);
+	(*v)->flags = flags;
+	if (l->flags & VAR_LIST_ARENA) (*v)->flags |= VAR_ITEM_ARENA;
+	if (len) memcpy((*v)->key, name, len);
+	(*v)->key[len] = '\0';
+	(*v)->keylen = len;
+	(*v)->type = VAR_TYPE_EMPTY;
+	(*v)->hash = _v_hash((*v)->key);
+
+	/* Make sure there is room in hash index. */
+	if (l->own_count >= l->hash_size && _v_hash_grow(l, l->own_count + 1) && !l->hash)
+	{
+		if (!((*v)->flags & VAR_ITEM_ARENA)) free(*v);
+		*v = NULL;
+		return;
+	}
+
+	/* Add to hash index, item must be complete before readers can see it. */
+	slot = &l->hash[(*v)->hash & (l->hash_size - 1)];
+	(*v)->hash_next = *slot;
+	__atomic_store_n(slot, *v, __ATOMIC_RELEASE);
+
+	/* Add to end of list to keep insertion order. */
+	if (!l->first)
+	{
+		l->first = *v;
+		l->last = *v;
+	}
+	else
+	{
+		(*v)->prev = l->last;
+		l->last->next = *v;
+		l->last = *v;
+	}
+	if (!(l->flags & VAR_LIST_INDEX)) _v_trie_add(&l->trie, (*v)->key, *v);
+	l->own_count++;
+	/* Item that has same name as item in base of list, hides it. */
+	if (flags & VAR_ITEM_DELETED) l->count--;
+	else if (!_v_find_layer(l->base, (*v)->key, (*v)->hash)) l->count++;
+	_v_slot_update(l, *v, !(flags & VAR_ITEM_DELETED));
+	_v_key_changed(l, (*v)->hash);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remove item from list and retire it.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_rm(struct var_list *l, struct var_item *v)
+{
+	struct var_item **slot;
+
+	/* Remove from hash index, readers on this item can still continue. */
+	for (slot = &l->hash[v->hash & (l->hash_size - 1)]; *slot; slot = &(*slot)->hash_next)
+	{
+		if (*slot == v)
+		{
+			__atomic_store_n(slot, v->hash_next, __ATOMIC_RELEASE);
+			break;
+		}
+	}
+
+	/* Remove from list. */
+	if (v->prev) v->prev->next = v->next;
+	else l->first = v->next;
+	if (v->next) v->next->prev = v->prev;
+	else l->last = v->prev;
+	if (l->current == v) l->current = _v_next(l, &l->current_layer, v);
+	_v_trie_rm(&l->trie, v->key);
+	l->own_count--;
+	if (!(v->flags & VAR_ITEM_DELETED)) l->count--;
+	_v_slot_update(l, v, 0);
+	_v_key_changed(l, v->hash);
+
+	_v_retire_data(l, v, v->type, v->data);
+	_v_retire(l, v, (v->flags & VAR_ITEM_ARENA) ? _v_item_arena_free : _v_item_free);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get stripe of global index for key with given hash.
+ * High bits of mixed hash are used, since stripe finds items with low bits.
+ */
+static inline int _v_keys_stripe(unsigned int hash)
+{
+	return (int)((hash * 2654435761U) >> (32 - VAR_KEYS_STRIPE_BITS));
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add list to or remove it from IDs of lists that
+ * have given key in global index.
+ * @note Caller must hold write lock of stripe of key.
+ *
+ * @param k Stripe of index, see _v_keys_stripe().
+ * @param add 1 to add, 0 to remove.
+ */
+static void _v_keys_mod(struct var_list *k, struct var_list *l, const char *name, unsigned int hash, int add)
+{
+	var_list_t *old = NULL, *lists, buf[VAR_KEYS_STACK];
+	struct var_item *v;
+	size_t size = 0, n, i;
+
+	v = _v_find_own(k, name, hash);
+	if (v) _v_get(v, (void **)&old, &size);
+	n = size / sizeof(*old);
+
+	/* IDs are kept in ascending order, so first list is found first. */
+	for (i = 0; i < n && old[i] < l->id; i++);
+	if ((i < n && old[i] == l->id) == add) return;
+
+	if (add) n++;
+	else n--;
+	if (n < 1)
+	{
+		_v_rm(k, v);
+		return;
+	}
+	lists = n > VAR_KEYS_STACK ? (var_list_t *)malloc(sizeof(*lists) * n) : buf;
+	if (!lists) goto out_err;
+	if (i > 0) memcpy(lists, old, sizeof(*lists) * i);
+	if (add)
+	{
+		lists[i] = l->id;
+		if (n > i + 1) memcpy(&lists[i + 1], &old[i], sizeof(*lists) * (n - i - 1));
+	}
+	else if (n > i) memcpy(&lists[i], &old[i + 1], sizeof(*lists) * (n - i));
+
+	if (!v) _v_new_flags(k, &v, name, 0);
+	if (v) _v_set(k, v, lists, sizeof(*lists) * n, VAR_TYPE_BIN);
+	if (lists != buf) free(lists);
+	/* Value is left as it was, if setting it failed. */
+	if (v && v->size == sizeof(*lists) * n) return;
+
+out_err:
+	__atomic_store_n(&var_keys_lost, 1, __ATOMIC_RELEASE);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add list to or remove it from IDs of lists that
+ * have given key in global index. Internal lists are not indexed.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_keys_update(struct var_list *l, const char *name, unsigned int hash, int add)
+{
+	struct var_list *k = &var_keys[_v_keys_stripe(hash)];
+
+	if (l->flags & VAR_LIST_LOCAL) return;
+	_v_lock_write(&k->lock, &k->stats.lock_wait_ns);
+	_v_keys_mod(k, l, name, hash, add);
+	lock_unlock(&k->lock);
+	/* Lookups from all lists might have used index before it was updated. */
+	_v_key_changed(l, hash);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add or remove all items visible in list to or
+ * from global index. Items are sorted by stripe first, so each stripe is
+ * locked only once.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_keys_list(struct var_list *l, int add)
+{
+	size_t end[VAR_KEYS_STRIPES], n = 0, i;
+	struct var_item *v, **items;
+	struct var_layer *layer;
+	struct var_list *k;
+	int s;
+
+	if (l->flags & VAR_LIST_LOCAL) return;
+	for (v = _v_next(l, &layer, NULL); v; v = _v_next(l, &layer, v)) n++;
+	if (n < 1) return;
+	items = (struct var_item **)malloc(sizeof(*items) * n);
+	if (!items)
+	{
+		__atomic_store_n(&var_keys_lost, 1, __ATOMIC_RELEASE);
+		return;
+	}
+
+	/* Count items of each stripe and place them after earlier stripes. */
+	memset(end, 0, sizeof(end));
+	for (v = _v_next(l, &layer, NULL); v; v = _v_next(l, &layer, v)) end[_v_keys_stripe(v->hash)]++;
+	for (s = 0, i = 0; s < VAR_KEYS_STRIPES; s++)
+	{
+		i += end[s];
+		end[s] = i - end[s];
+	}
+	for (v = _v_next(l, &layer, NULL); v; v = _v_next(l, &layer, v)) items[end[_v_keys_stripe(v->hash)]++] = v;
+
+	for (s = 0, i = 0; s < VAR_KEYS_STRIPES; s++)
+	{
+		if (i == end[s]) continue;
+		k = &var_keys[s];
+		_v_lock_write(&k->lock, &k->stats.lock_wait_ns);
+		for ( ; i < end[s]; i++) _v_keys_mod(k, l, items[i]->key, items[i]->hash, add);
+		lock_unlock(&k->lock);
+	}
+	free(items);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Allocate new item in list.
+ * @note Caller must hold write lock of list.
+ */
+void _v_new(struct var_item **v, var_list_t list, char *name)
+{
+	_v_new_flags(_v_list(list), v, name, 0);
+	if (*v) _v_keys_update(_v_list(list), (*v)->key, (*v)->hash, 1);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remove and retire all items from list.
+ * @note Caller must hold write lock of list.
+ */
+static void _v_clear(struct var_list *l)
+{
+	struct var_item *v, *next;
+	struct var_layer *layer = NULL;
+
+	/* Hide items from readers first. */
+	v = l->first;
+	l->first = NULL;
+	_v_hash_publish(l, NULL, 0);
+	_v_layer_put(l, __atomic_exchange_n(&l->base, NULL, __ATOMIC_ACQ_REL));
+	_v_changed(l);
+
+	/* Items of arena list are retired with the arena as one layer. */
+	if ((l->flags & VAR_LIST_ARENA) && v) layer = (struct var_layer *)calloc(1, sizeof(*layer));
+	if (layer)
+	{
+		layer->first = v;
+		layer->arena = l->arena;
+		layer->trie = l->trie;
+		_v_retire(l, layer, _v_layer_free);
+		l->arena = NULL;
+		l->trie = NULL;
+	}
+	for (v = layer ? NULL : v; v; v = next)
+	{
+		next = v->next;
+		_v_retire_data(l, v, v->type, v->data);
+		_v_retire(l, v, (v->flags & VAR_ITEM_ARENA) ? _v_item_arena_free : _v_item_free);
+	}
+	_v_retire(l, l->arena, _v_arena_free);
+	l->arena = NULL;
+	_v_trie_free(l->trie);
+	l->trie = NULL;
+	_v_slot_clear(l);
+
+	l->first = NULL;
+	l->last = NULL;
+	l->current = NULL;
+	l->current_layer = NULL;
+	l->count = 0;
+	l->own_count = 0;
+	l->auto_array_counter = 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable from single list using hash index.
+ * If not found from list itself, it is searched from base of list.
+ * Search is retried if hash index was replaced while searching.
+ * @note Wont lock var_list, caller must be inside var_read_begin()
+ *       or hold lock of list.
+ *
+ * @return Pointer to variable struct, or NULL if not found or deleted.
+ */
+static struct var_item *_v_find_in_hash(struct var_list *l, const char *name, unsigned int hash)
+{
+	struct var_item **table, *v;
+	struct var_layer *base;
+	unsigned int seq;
+	size_t size;
+
+	do
+	{
+		/* Wait while hash index is being replaced. */
+		while ((seq = __atomic_load_n(&l->hash_seq, __ATOMIC_ACQUIRE)) & 1);
+
+		size = __atomic_load_n(&l->hash_size, __ATOMIC_ACQUIRE);
+		table = __atomic_load_n(&l->hash, __ATOMIC_ACQUIRE);
+		v = _v_find_table(table, size, name, hash);
+		if (v) return (__atomic_load_n(&v->flags, __ATOMIC_ACQUIRE) & VAR_ITEM_DELETED) ? NULL : v;
+		base = __atomic_load_n(&l->base, __ATOMIC_ACQUIRE);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	} while (seq != __atomic_load_n(&l->hash_seq, __ATOMIC_RELAXED));
+
+	return _v_find_layer(base, name, hash);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable from single list, see
+ * _v_find_in_hash(). With statistics enabled, lookup is counted to list.
+ * @note Wont lock var_list, caller must be inside var_read_begin()
+ *       or hold lock of list.
+ */
+static inline struct var_item *_v_find_in(struct var_list *l, const char *name, unsigned int hash)
+{
+#ifdef VAR_STATS
+	uint64_t scanned = var_stat_scanned;
+	struct var_item *v = _v_find_in_hash(l, name, hash);
+
+	VAR_STAT_ADD(l->stats.gets, 1);
+	VAR_STAT_ADD(l->stats.scanned, var_stat_scanned - scanned);
+	if (!v) VAR_STAT_ADD(l->stats.misses, 1);
+	return v;
+#else
+	return _v_find_in_hash(l, name, hash);
+#endif
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get IDs of lists that have given key from global
+ * index.
+ * @note Wont lock index, caller must be inside var_read_begin().
+ *
+ * @param lists Set to IDs, valid until var_read_end().
+ * @return Number of IDs, or -1 if index is not up to date.
+ */
+static int _v_keys_get(const char *name, unsigned int hash, const var_list_t **lists)
+{
+	struct var_item *v;
+	size_t size;
+
+	if (__atomic_load_n(&var_keys_lost, __ATOMIC_ACQUIRE)) return -1;
+	v = _v_find_in(&var_keys[_v_keys_stripe(hash)], name, hash);
+	if (!v || _v_get(v, (void **)lists, &size) != VAR_TYPE_BIN) return 0;
+
+	return size / sizeof(**lists);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Copy IDs of lists that have given key from global
+ * index, for going trough lists while changing them.
+ *
+ * @param lists Set to allocated IDs, must be freed by caller.
+ * @return Number of IDs, or -1 if index is not up to date or on errors.
+ */
+static int _v_keys_copy(const char *name, unsigned int hash, var_list_t **lists)
+{
+	const var_list_t *ids;
+	int n;
+
+	if (var_read_begin()) return -1;
+	n = _v_keys_get(name, hash, &ids);
+	*lists = n > 0 ? (var_list_t *)malloc(sizeof(*ids) * n) : NULL;
+	if (*lists) memcpy(*lists, ids, sizeof(*ids) * n);
+	else if (n > 0) n = -1;
+	var_read_end();
+
+	return n;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set item in list itself.
+ * Items in base of list are shared with copies of list and are never
+ * changed, instead new item is created to list itself to hide the shared
+ * one. Deleted item is brought back, when it is set again.
+ * @note Caller must hold write lock of list.
+ *
+ * @param create Whether to create item, if it does not exist.
+ * @param own Whether data is given to item, see _v_set_data().
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_put_data(struct var_list *l, const char *name, unsigned int hash, int create,
+                       void *data, int size, int type, int own)
+{
+	struct var_item *v = _v_find_own(l, name, hash);
+	int shared = 0;
+
+	VAR_STAT_ADD(l->stats.sets, 1);
+	if (!v && _v_find_layer(l->base, name, hash)) create = shared = 1;
+	if (v && (v->flags & VAR_ITEM_DELETED))
+	{
+		if (!create)
+		{
+			if (own) free(data);
+			return 0;
+		}
+		/* Value must be set before readers can see item again. */
+		_v_set_data(l, v, data, size, type, own);
+		__atomic_and_fetch(&v->flags, ~VAR_ITEM_DELETED, __ATOMIC_RELEASE);
+		l->count++;
+		_v_slot_update(l, v, 1);
+		_v_key_changed(l, hash);
+		_v_keys_update(l, name, hash, 1);
+		return 0;
+	}
+	if (!v && create)
+	{
+		_v_new_flags(l, &v, name, 0);
+		/* Item in base of list is already indexed. */
+		if (v && !shared) _v_keys_update(l, name, hash, 1);
+	}
+	if (!v)
+	{
+		if (own) free(data);
+		return create ? -1 : 0;
+	}
+	_v_set_data(l, v, data, size, type, own);
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set item in list itself, see _v_put_data().
+ * @note Caller must hold write lock of list.
+ */
+static inline int _v_put(struct var_list *l, const char *name, unsigned int hash, int create, void *data, int size, int type)
+{
+	return _v_put_data(l, name, hash, create, data, size, type, 0);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remove item from list.
+ * Item shared with copies of list is hidden by deleted item.
+ * @note Caller must hold write lock of list.
+ *
+ * @return 1 if item was removed, 0 if not found, -1 on errors.
+ */
+static int _v_rm_name(struct var_list *l, const char *name, unsigned int hash)
+{
+	struct var_item *v = _v_find_own(l, name, hash);
+
+	if (v && (v->flags & VAR_ITEM_DELETED)) return 0;
+	if (!_v_find_layer(l->base, name, hash))
+	{
+		if (!v) return 0;
+		_v_rm(l, v);
+		_v_keys_update(l, name, hash, 0);
+		return 1;
+	}
+
+	if (!v)
+	{
+		_v_new_flags(l, &v, name, VAR_ITEM_DELETED);
+		if (!v) return -1;
+		_v_keys_update(l, name, hash, 0);
+		return 1;
+	}
+	if (l->current == v) l->current = _v_next(l, &l->current_layer, v);
+	__atomic_or_fetch(&v->flags, VAR_ITEM_DELETED, __ATOMIC_RELEASE);
+	l->count--;
+	_v_slot_update(l, v, 0);
+	_v_key_changed(l, hash);
+	_v_keys_update(l, name, hash, 0);
+
+	return 1;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Move items of list to new layer, which can then
+ * be shared with copies of list. List itself is left empty, with the new
+ * layer as its base.
+ * @note Caller must hold write lock of list.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_freeze(struct var_list *l)
+{
+	struct var_layer *layer;
+
+	if (!l->first) return 0;
+	layer = (struct var_layer *)malloc(sizeof(*layer));
+	if (!layer) return -1;
+	layer->first = l->first;
+	layer->hash = l->hash;
+	layer->hash_size = l->hash_size;
+	layer->trie = l->trie;
+	layer->arena = l->arena;
+	layer->image = NULL;
+	layer->base = l->base;
+	layer->depth = l->base ? l->base->depth + 1 : 1;
+	layer->refs = 1;
+
+	/* Readers must see either the old index or the new base. */
+	__atomic_store_n(&l->hash_seq, l->hash_seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&l->hash_size, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&l->hash, NULL, __ATOMIC_RELAXED);
+	__atomic_store_n(&l->base, layer, __ATOMIC_RELEASE);
+	__atomic_store_n(&l->hash_seq, l->hash_seq + 1, __ATOMIC_RELEASE);
+
+	l->first = NULL;
+	l->last = NULL;
+	l->arena = NULL;
+	l->trie = NULL;
+	l->own_count = 0;
+	if (l->current && !l->current_layer) l->current_layer = layer;
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Copy items visible from base of list to list
+ * itself and release base, so that finding items does not need to go
+ * trough too many layers. Items keep their order.
+ * @note Caller must hold write lock of list.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_flatten(struct var_list *l)
+{
+	struct var_item *v, *c, *first = l->first, *last = l->last, *next;
+	struct var_layer *layer, *base = l->base;
+	struct var_num n;
+	int err = 0;
+
+	for (v = _v_next(l, &layer, NULL); v && layer; v = _v_next(l, &layer, v))
+	{
+		_v_new_flags(l, &c, v->key, 0);
+		if (!c)
+		{
+			err = -1;
+			break;
+		}
+		/* String form of number belongs to original. */
+		if (VAR_TYPE_IS_NUM(v->type))
+		{
+			memcpy(&n, v->data, sizeof(n));
+			n.str = NULL;
+			_v_set(l, c, &n, sizeof(n), v->type);
+		}
+		else if (v->data) _v_set(l, c, v->data, v->size, v->type);
+		if (l->current == v)
+		{
+			l->current = c;
+			l->current_layer = NULL;
+		}
+	}
+
+	/* Copies were added to end, move them before items of list itself. */
+	if (last && last != l->last)
+	{
+		c = last->next;
+		c->prev = NULL;
+		last->next = NULL;
+		l->last->next = first;
+		first->prev = l->last;
+		l->first = c;
+		l->last = last;
+	}
+	if (err) return -1;
+
+	__atomic_store_n(&l->base, NULL, __ATOMIC_RELEASE);
+	_v_layer_put(l, base);
+	_v_changed(l);
+
+	/* Deleted items have nothing to hide anymore. */
+	for (v = l->first; v; v = next)
+	{
+		next = v->next;
+		if (v->flags & VAR_ITEM_DELETED) _v_rm(l, v);
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add list to list name index.
+ * Index is grown when there are more lists than slots.
+ * @note Wont lock var_list.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_names_add(var_list_t list)
+{
+	var_list_t *names, i;
+	size_t size, slot;
+
+	_v_list(list)->name_next = -1;
+	_v_list(list)->name_hash = _v_hash(_v_list(list)->name);
+	/* Default or unnamed lists are not indexed. */
+	if (_v_list(list)->name[0] == '\0') return 0;
+
+	if ((size_t)var_list_c >= var_list_names_size)
+	{
+		size = var_list_names_size ? var_list_names_size * 2 : VAR_HASH_MIN_SIZE;
+		names = (var_list_t *)malloc(sizeof(*names) * size);
+		if (!names) return -1;
+		for (slot = 0; slot < size; slot++) names[slot] = -1;
+		for (i = 0; i < var_list_c; i++)
+		{
+			if (i == list || _v_list(i)->name[0] == '\0') continue;
+			slot = _v_list(i)->name_hash & (size - 1);
+			_v_list(i)->name_next = names[slot];
+			names[slot] = i;
+		}
+		if (var_list_names) free(var_list_names);
+		var_list_names = names;
+		var_list_names_size = size;
+	}
+
+	slot = _v_list(list)->name_hash & (var_list_names_size - 1);
+	_v_list(list)->name_next = var_list_names[slot];
+	var_list_names[slot] = list;
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remove list from list name index.
+ * @note Wont lock var_list.
+ */
+static void _v_names_rm(var_list_t list)
+{
+	var_list_t *slot;
+
+	if (!var_list_names) return;
+	slot = &var_list_names[_v_list(list)->name_hash & (var_list_names_size - 1)];
+	for ( ; *slot > -1; slot = &_v_list(*slot)->name_next)
+	{
+		if (*slot == list)
+		{
+			*slot = _v_list(list)->name_next;
+			break;
+		}
+	}
+	_v_list(list)->name_next = -1;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find list using list name index.
+ * If more than one list has the same name, lowest ID is returned.
+ * @note Wont lock var_list.
+ *
+ * @return List ID or -1 if not found.
+ */
+static var_list_t _v_names_find(const char *name)
+{
+	var_list_t i, found = -1;
+	unsigned int hash;
+
+	if (!var_list_names) return -1;
+	hash = _v_hash(name);
+	for (i = var_list_names[hash & (var_list_names_size - 1)]; i > -1; i = _v_list(i)->name_next)
+	{
+		if (_v_list(i)->name_hash != hash || strcmp(_v_list(i)->name, name) != 0) continue;
+		if (found < 0 || i < found) found = i;
+	}
+
+	return found;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether calling thread has overlay
+ * active, see var_overlay_begin().
+ */
+static inline int _v_overlay_on(void)
+{
+	return var_reader && var_reader->shadow_c > 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether list is shadowed by overlay.
+ */
+static int _v_shadowed(struct var_reader *r, var_list_t list)
+{
+	int i;
+
+	for (i = 0; i < r->shadow_c; i++)
+	{
+		if (r->shadow[i] == list || r->shadow[i] < 0) return 1;
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get smallest ID of list shadowed by overlay.
+ *
+ * @param n Number of lists.
+ * @return List ID, or n if no list is shadowed.
+ */
+static int _v_shadow_first(struct var_reader *r, int n)
+{
+	int i, s = n;
+
+	for (i = 0; i < r->shadow_c; i++)
+	{
+		if (r->shadow[i] < 0) return 0;
+		if (r->shadow[i] < s) s = r->shadow[i];
+	}
+
+	return s;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable using already calculated hash.
+ * Overlay of calling thread is searched before lists it shadows.
+ * @note Wont lock var_list.
+ */
+static struct var_item *_v_find_hash(var_list_t list, const char *name, unsigned int hash)
+{
+	struct var_reader *r = var_reader;
+	struct var_item *v = NULL, *o = NULL;
+	const var_list_t *ids;
+	int i, n, c, s;
+	
+	/* Check search conditions. */
+	n = _v_lists();
+	if (list < 0) i = 0;
+	else if (list < n)
+	{
+		i = list;
+		n = list + 1;
+	}
+	else return NULL;
+
+	if (_v_overlay_on()) o = _v_find_in(r->overlay, name, hash);
+
+	/* From all lists, search only lists that have the item. */
+	if (list < 0 && !var_read_begin())
+	{
+		c = _v_keys_get(name, hash, &ids);
+		if (c > -1)
+		{
+			s = o ? _v_shadow_first(r, n) : n;
+			for (i = 0; i < c && ids[i] < s && !v; i++) v = _v_find_in(_v_list(ids[i]), name, hash);
+			if (!v && s < n) v = o;
+			var_read_end();
+			return v;
+		}
+		var_read_end();
+	}
+
+	for ( ; i < n; i++)
+	{
+		if (o && _v_shadowed(r, i)) return o;
+		v = _v_find_in(_v_list(i), name, hash);
+		if (v) return v;
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable.
+ * @note Wont lock var_list.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of variable to find.
+ * @return Pointer to variable struct, or NULL.
+ */
+struct var_item *_v_find(var_list_t list, char *name)
+{
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return NULL;
+	if (!name) return NULL;
+
+	return _v_find_hash(list, name, _v_hash(name));
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable by index.
+ * Index out of array of list is found by name.
+ * @note Wont lock var_list, caller must be inside var_read_begin()
+ *       or hold lock of list.
+ *
+ * @return Pointer to variable struct, or NULL.
+ */
+static struct var_item *_v_at(struct var_list *l, int index)
+{
+	struct var_item **slot, *v;
+	char key[12];
+	size_t size;
+
+	if (index < 0) return NULL;
+	size = __atomic_load_n(&l->slot_size, __ATOMIC_ACQUIRE);
+	slot = __atomic_load_n(&l->slot, __ATOMIC_ACQUIRE);
+	if (slot && (size_t)index < size)
+	{
+		VAR_STAT_ADD(l->stats.gets, 1);
+		v = __atomic_load_n(&slot[index], __ATOMIC_ACQUIRE);
+		if (v && (__atomic_load_n(&v->flags, __ATOMIC_ACQUIRE) & VAR_ITEM_DELETED)) v = NULL;
+		if (!v) VAR_STAT_ADD(l->stats.misses, 1);
+		return v;
+	}
+
+	_v_index_key(key, index);
+	return _v_find_in(l, key, _v_hash(key));
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set variable by index.
+ * Item of list without base is set right away, others are set by name.
+ * @note Caller must hold write lock of list.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_at_put(struct var_list *l, int index, void *data, int size, int type)
+{
+	struct var_item *v = NULL;
+	char key[12];
+
+	if (index < 0) return -1;
+	if (!l->base && (size_t)index < l->slot_size) v = l->slot[index];
+	if (v && !(v->flags & VAR_ITEM_DELETED))
+	{
+		VAR_STAT_ADD(l->stats.sets, 1);
+		_v_set(l, v, data, size, type);
+		return 0;
+	}
+
+	_v_index_key(key, index);
+	return _v_put(l, key, _v_hash(key), 1, data, size, type);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set variable by index to list given by ID.
+ * Index -1 appends to list.
+ *
+ * @return Index of variable, or -1 on errors.
+ */
+static int _v_at_set(var_list_t list, int index, void *data, int size, int type)
+{
+	struct var_list *l;
+	int err;
+
+	/* Return error, if lib not initialized yet or list is invalid. */
+	if (list < 0 || list >= _v_lists()) return -1;
+	l = _v_list(list);
+
+	if (_v_lock_list(l)) return -1;
+	if (index < 0)
+	{
+		if (!(l->flags & VAR_LIST_ARRAY) || l->slot_c >= INT_MAX) index = -2;
+		else index = (int)l->slot_c;
+	}
+	err = _v_at_put(l, index, data, size, type);
+	lock_unlock(&l->lock);
+
+	return err ? -1 : index;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set variable data to given.
+ * @note Lock's lists one at a time when needed.
+ *
+ * @param list ID of list to be used.
+ * @param name Name of item to be set.
+ * @param data Pointer to data to be set.
+ * @param size Size of data.
+ * @param type Type of data to be set.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int _v_list_set(var_list_t list, const char *name, void *data, int size, int type)
+{
+	int i, n, c, create, err = 0;
+	unsigned int hash;
+	struct var_list *l;
+	struct var_item *v;
+	var_list_t *ids;
+	char *name_real = (char *)name;
+	
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+	/* Return error, if name is invalid. */
+	if (!name) return -1;
+
+	/* Check search conditions. */
+	n = _v_lists();
+	if (list < 0)
+	{
+		i = 0;
+		create = 0;
+	}
+	else if (list < n)
+	{
+		i = list;
+		n = list + 1;
+		create = 1;
+	}
+	else return -1;
+
+	/* Existing items in all lists are set only to lists that have them. */
+	if (list < 0 && name && (c = _v_keys_copy(name, _v_hash(name), &ids)) > -1)
+	{
+		for (hash = _v_hash(name), i = 0; i < c; i++)
+		{
+			if (ids[i] >= n) continue;
+			l = _v_list(ids[i]);
+			if (_v_lock_list(l))
+			{
+				err = -1;
+				continue;
+			}
+			_v_put(l, name, hash, 0, data, size, type);
+			lock_unlock(&l->lock);
+		}
+		if (ids) free(ids);
+		return err;
+	}
+
+	/* Go trough requested item(s). */
+	for ( ; i < n; i++)
+	{
+		l = _v_list(i);
+		if (_v_lock_list(l))
+		{
+			err = -1;
+			continue;
+		}
+
+		/* if name is null, autogenerate it */
+		while (!name && i > 0)
+		{
+			if (name_real) free(name_real);
+			asprintf(&name_real, "%d", l->auto_array_counter);
+			v = _v_find(i, name_real);
+			l->auto_array_counter++;
+			if (!v) break;
+		}
+
+		/* Set item, create new one if needed. */
+		hash = _v_hash(name_real);
+		_v_put(l, name_real, hash, create, data, size, type);
+
+		lock_unlock(&l->lock);
+	}
+
+	if (!name && name_real) free(name_real);
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set variable data to given and give data to item.
+ * Data set to all lists is copied to each item, and then freed.
+ *
+ * @param data Data allocated with malloc(), always freed or kept by item.
+ * @return Returns 0 on success, -1 on errors.
+ */
+static int _v_list_set_own(var_list_t list, const char *name, void *data, int size, int type)
+{
+	struct var_list *l;
+	int err;
+
+	if (list < 0 || list >= _v_lists() || !name)
+	{
+		err = _v_list_set(list, name, data, size, type);
+		free(data);
+		return err;
+	}
+
+	l = _v_list(list);
+	if (_v_lock_list(l))
+	{
+		free(data);
+		return -1;
+	}
+	err = _v_put_data(l, name, _v_hash(name), 1, data, size, type, 1);
+	lock_unlock(&l->lock);
+
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Append to string builder.
+ * Length is tracked, so appending never rescans the string, and buffer
+ * size is doubled when more is needed, so building is linear in length
+ * of result. Buffer is kept null terminated.
+ *
+ * @param b Builder to append to.
+ * @param src Source string, does not need to be null terminated.
+ * @param n Number of characters to append.
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_buf_add(struct var_buf *b, const char *src, size_t n)
+{
+	size_t size;
+	char *p;
+
+	if (n < 1) return 0;
+	if (b->len + n >= b->size)
+	{
+		size = b->size ? b->size : VAR_MIN_MALLOC;
+		while (size <= b->len + n) size *= 2;
+		p = (char *)realloc(b->p, size);
+		if (!p) return -1;
+		b->p = p;
+		b->size = size;
+	}
+	memcpy(&b->p[b->len], src, n);
+	b->len += n;
+	b->p[b->len] = '\0';
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Free lines of parsed file.
+ */
+static void _v_stage_free(struct var_stage *st)
+{
+	if (st->b.p) free(st->b.p);
+	if (st->line) free(st->line);
+	memset(&st->b, 0, sizeof(st->b));
+	st->line = NULL;
+	st->line_c = 0;
+	st->line_size = 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Free watched file.
+ */
+static void _v_watch_free(struct var_watch *w)
+{
+	_v_stage_free(&w->stage);
+	if (w->index) free(w->index);
+	w->index = NULL;
+	w->index_size = 0;
+	free(w->path);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Resolve variable referenced from template.
+ * Result is cached in token while no items with same key are added or
+ * removed. When searching more than one list or when overlay is active,
+ * result is not cached.
+ * @note Wont lock var_list, caller must be inside var_read_begin().
+ *
+ * @param key_version Set to version of key, taken before lookup.
+ * @return Pointer to variable struct, or NULL.
+ */
+static struct var_item *_v_tmpl_resolve(struct var_tmpl_tok *t, int *lists, int lc, unsigned int *key_version)
+{
+	unsigned long version = __atomic_load_n(&var_items_version, __ATOMIC_ACQUIRE);
+	unsigned int kv = _v_key_version(t->hash);
+	struct var_item *v = NULL;
+	unsigned int seq = 1;
+	int j;
+
+	if (lc == 1 && !_v_overlay_on())
+	{
+		seq = __atomic_load_n(&t->cache_seq, __ATOMIC_ACQUIRE);
+		if (!(seq & 1) &&
+		    __atomic_load_n(&t->cache_list, __ATOMIC_RELAXED) == lists[0] &&
+		    __atomic_load_n(&t->cache_version, __ATOMIC_RELAXED) == version &&
+		    __atomic_load_n(&t->cache_key_version, __ATOMIC_RELAXED) == kv)
+		{
+			v = __atomic_load_n(&t->cache_item, __ATOMIC_RELAXED);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (seq == __atomic_load_n(&t->cache_seq, __ATOMIC_RELAXED))
+			{
+				*key_version = kv;
+				return v;
+			}
+			v = NULL;
+		}
+	}
+
+	for (j = 0; j < lc && !v; j++) v = _v_find_hash(lists[j], t->str, t->hash);
+
+	/* Update cache, unless other thread is already updating it. */
+	if (!(seq & 1) && __atomic_compare_exchange_n(&t->cache_seq, &seq, seq + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+	{
+		__atomic_store_n(&t->cache_list, lists[0], __ATOMIC_RELAXED);
+		__atomic_store_n(&t->cache_version, version, __ATOMIC_RELAXED);
+		__atomic_store_n(&t->cache_key_version, kv, __ATOMIC_RELAXED);
+		__atomic_store_n(&t->cache_item, v, __ATOMIC_RELAXED);
+		__atomic_store_n(&t->cache_seq, seq + 2, __ATOMIC_RELEASE);
+	}
+
+	*key_version = kv;
+	return v;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remember item that parse result depends on.
+ *
+ * @param v Item, or NULL if key was not found.
+ * @param seq Sequence of item when it was read.
+ * @param hash Hash of key.
+ * @param key_version Version of key when it was looked up.
+ */
+static void _v_parse_dep(struct var_parse *p, struct var_item *v, unsigned int seq,
+                         unsigned int hash, unsigned int key_version)
+{
+	struct var_memo_dep *dep;
+	size_t size;
+
+	if (p->dep_c >= p->dep_size)
+	{
+		size = p->dep_size ? p->dep_size * 2 : 16;
+		dep = (struct var_memo_dep *)realloc(p->dep, sizeof(*dep) * size);
+		if (!dep)
+		{
+			p->err = 1;
+			return;
+		}
+		p->dep = dep;
+		p->dep_size = size;
+	}
+	p->dep[p->dep_c].item = v;
+	p->dep[p->dep_c].seq = seq;
+	p->dep[p->dep_c].hash = hash;
+	p->dep[p->dep_c].key_version = key_version;
+	p->dep_c++;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether memo is still valid.
+ * Item memo depends on cannot have been freed while version of its key
+ * is the same, since removing item changes it before item is retired.
+ * @note Caller must be inside var_read_begin().
+ *
+ * @return 1 if valid, 0 if not.
+ */
+static int _v_memo_valid(struct var_memo *m, int list, unsigned long version)
+{
+	struct var_memo_dep *d;
+	size_t i;
+
+	if (m->version != version || m->list != list) return 0;
+	for (i = 0; i < m->count; i++)
+	{
+		d = &m->dep[i];
+		if (_v_key_version(d->hash) != d->key_version) return 0;
+		if (d->item && __atomic_load_n(&d->item->seq, __ATOMIC_ACQUIRE) != d->seq) return 0;
+	}
+
+	return 1;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check whether memo depends on items being parsed.
+ *
+ * @return 1 if it does, 0 if not.
+ */
+static int _v_memo_on_stack(struct var_memo *m, struct var_list *recursion)
+{
+	struct var_item *node;
+	size_t i;
+
+	for (i = 0; i < m->count; i++)
+	{
+		for (node = recursion->first; node; node = node->next)
+		{
+			if (m->dep[i].item && node->data == m->dep[i].item) return 1;
+		}
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Store parse result of item as its memo.
+ * Memo is stored only if item still has the memo given as old.
+ * @note Caller must be inside var_read_begin().
+ */
+static void _v_memo_store(struct var_item *v, struct var_memo *old, struct var_parse *p,
+                          size_t start, size_t dep_start, int cut, int list)
+{
+	struct var_memo *m;
+	size_t len = p->b.len - start, count = p->dep_c - dep_start;
+
+	m = (struct var_memo *)malloc(sizeof(*m) + sizeof(m->dep[0]) * count + len + 1);
+	if (!m) return;
+	m->version = p->version;
+	m->list = list;
+	m->cut = cut;
+	m->len = len;
+	m->count = count;
+	memcpy(m->dep, &p->dep[dep_start], sizeof(m->dep[0]) * count);
+	m->str = (char *)&m->dep[count];
+	if (len) memcpy(m->str, &p->b.p[start], len);
+	m->str[len] = '\0';
+
+	if (__atomic_compare_exchange_n(&v->memo, &old, m, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+	{
+		_v_retire_local(old, free);
+	}
+	else free(m);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Parse variable into buffer.
+ * Strings are rendered from their compiled template, referenced
+ * variables are parsed straight into the same buffer.
+ * Result of items with variables is kept as memo of the item, and used
+ * while the items it was parsed from stay the same. Memo is used only
+ * when searching single list, and inside other parse only if it did
+ * not stop to recursion and does not depend on items being parsed.
+ * @note Wont lock var_list, caller must be inside var_read_begin().
+ *
+ * @param v Item to parse.
+ * @param p Parse state, result is appended to its buffer.
+ * @param recursion Stack of items being parsed, for detecting recursion.
+ * @param lists List IDs, which are used when searhing variables in string.
+ * @param lc Number of items in lists.
+ * @param key_version Version of key of item, taken before it was looked up.
+ */
+static void _v_parse(struct var_item *v, struct var_parse *p, struct var_list *recursion, int *lists, int lc,
+                     unsigned int key_version)
+{
+	struct var_item node, *prevnode = NULL, *subv;
+	struct var_memo *memo = NULL;
+	struct var_tmpl *tmpl;
+	size_t i, size, start, dep_start;
+	unsigned int seq, kv;
+	int type, cut, top;
+	void *data;
+	char *str;
+
+	/*
+	 * Check that this node is not already visited previously on
+	 * lower level. If this check is not done, we could end up in
+	 * dead lock, adding contents of variables inside each other.
+	 */
+	for (prevnode = recursion->first; prevnode; prevnode = prevnode->next)
+	{
+		if (prevnode->data == v)
+		{
+			p->cut++;
+			return;
+		}
+	}
+	prevnode = NULL;
+	top = recursion->first ? 0 : 1;
+
+	/* Add current item to recursion stack. */
+	node.data = v;
+	node.next = NULL;
+	if (!recursion->first)
+	{
+		recursion->first = &node;
+		recursion->last = &node;
+	}
+	else
+	{
+		recursion->last->next = &node;
+		prevnode = recursion->last;
+		recursion->last = &node;
+	}
+	recursion->count++;
+
+	type = _v_get_tmpl(v, &data, &size, &tmpl, &seq);
+	if (tmpl && p->cache)
+	{
+		memo = __atomic_load_n(&v->memo, __ATOMIC_ACQUIRE);
+		if (memo && _v_memo_valid(memo, lists[0], p->version) &&
+		    (top || (!memo->cut && !_v_memo_on_stack(memo, recursion))))
+		{
+			if (_v_buf_add(&p->b, memo->str, memo->len)) p->err = 1;
+			for (i = 0; i < memo->count; i++)
+			{
+				_v_parse_dep(p, memo->dep[i].item, memo->dep[i].seq, memo->dep[i].hash, memo->dep[i].key_version);
+			}
+			VAR_STAT_ADD(var_stat_memo_hits, 1);
+			goto out;
+		}
+	}
+
+	start = p->b.len;
+	dep_start = p->dep_c;
+	cut = p->cut;
+	_v_parse_dep(p, v, seq, v->hash, key_version);
+
+	if (tmpl)
+	{
+		VAR_STAT_ADD(var_stat_expands, 1);
+		for (i = 0; i < tmpl->count; i++)
+		{
+			if (!tmpl->tok[i].ref)
+			{
+				if (_v_buf_add(&p->b, tmpl->tok[i].str, tmpl->tok[i].len)) p->err = 1;
+				continue;
+			}
+			subv = _v_tmpl_resolve(&tmpl->tok[i], lists, lc, &kv);
+			if (subv) _v_parse(subv, p, recursion, lists, lc, kv);
+			else _v_parse_dep(p, NULL, 0, tmpl->tok[i].hash, kv);
+		}
+
+		/* Result depending on items above this one can not be reused. */
+		if (p->cache && !p->err && (top || p->cut == cut))
+		{
+			_v_memo_store(v, memo, p, start, dep_start, p->cut != cut, lists[0]);
+		}
+	}
+	else if (type == VAR_TYPE_STR)
+	{
+		/* Size of strings includes terminating null char. */
+		if (size > 0 && ((char *)data)[size - 1] == '\0') size--;
+		if (_v_buf_add(&p->b, data, size)) p->err = 1;
+	}
+	else
+	{
+		str = _v_str(type, data);
+		if (str && _v_buf_add(&p->b, str, strlen(str))) p->err = 1;
+	}
+
+out:
+	/* Remove us from the recursion stack. */
+	if (recursion->count > 0)
+	{
+		recursion->last = prevnode;
+		if (prevnode) recursion->last->next = NULL;
+		else recursion->first = NULL;
+		recursion->count--;
+	}
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find longest key from prefix tree that is
+ * beginning of given string. Only keys longer than given length and
+ * items visible in list are accepted.
+ * @note Caller must hold lock of list.
+ *
+ * @param len Length of best match so far, updated if longer is found.
+ * @return Item visible in list with found key, or NULL.
+ */
+static struct var_item *_v_trie_best(struct var_list *l, struct var_trie *t, const char *str, size_t *len)
+{
+	struct var_item *v, *best = NULL;
+	const char *p = str;
+
+	while (*p)
+	{
+		for ( ; t && t->label[0] != *p; t = t->next);
+		if (!t || strncmp(t->label, p, t->len) != 0) break;
+		p += t->len;
+		/* Item might be deleted or hidden by newer one with same key. */
+		if (t->item && (size_t)(p - str) > *len)
+		{
+			v = _v_find_in(l, t->item->key, t->item->hash);
+			if (v)
+			{
+				best = v;
+				*len = p - str;
+			}
+		}
+		t = t->child;
+	}
+
+	return best;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find best match for keystr from variables.
+ * Best match is the longest variable name that keystr begins with.
+ * If lists have matches of same length, the one from first list is used.
+ * @note Lock's lists one at a time while searching.
+ *
+ * @param list List ID which to used in search.
+ * @param keystr String which to try match variables name.
+ * @return Pointer to variable struct, or NULL.
+ */
+struct var_item *_v_find_best(var_list_t list, char *keystr)
+{
+	struct var_reader *r = var_reader;
+	struct var_list *o = _v_overlay_on() ? r->overlay : NULL;
+	struct var_item *v, *vret = NULL;
+	struct var_layer *layer;
+	struct var_list *l;
+	size_t len;
+	int i, n;
+	
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return NULL;
+	
+	/* Check search conditions. */
+	n = _v_lists();
+	if (list < 0) i = 0;
+	else if (list < n)
+	{
+		i = list;
+		n = list + 1;
+	}
+	else return NULL;
+
+	for (len = 0; i < n; i++)
+	{
+		/* Overlay wins matches of same length from lists it shadows. */
+		if (o && _v_shadowed(r, i))
+		{
+			v = _v_trie_best(o, o->trie, keystr, &len);
+			if (v) vret = v;
+			o = NULL;
+		}
+		l = _v_list(i);
+		_v_lock_read(&l->lock, &l->stats.lock_wait_ns);
+		v = _v_trie_best(l, l->trie, keystr, &len);
+		if (v) vret = v;
+		for (layer = l->base; layer; layer = layer->base)
+		{
+			v = _v_trie_best(l, layer->trie, keystr, &len);
+			if (v) vret = v;
+		}
+		lock_unlock(&l->lock);
+	}
+
+	return vret;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Expand variables in string, see VAR_OPT_EXPAND.
+ * Each $ followed by name of variable is replaced by value of variable
+ * with best matching name. Result is built to buffer of calling thread.
+ * @note Wont lock var_list, caller must be inside var_read_begin().
+ *
+ * @param list List ID which to used in search.
+ * @param str String to expand.
+ * @return Expanded string, valid until next call from same thread, or
+ *         given string on errors.
+ */
+static const char *_v_expand(var_list_t list, const char *str)
+{
+	static __thread struct var_buf b;
+	const char *e, *src = str, *sv;
+	struct var_item *v;
+	void *data;
+	int type;
+
+	b.len = 0;
+	while ((e = strpbrk(src, VAR_CHARS)))
+	{
+		v = _v_find_best(list, (char *)e + 1);
+		if (!v)
+		{
+			if (_v_buf_add(&b, src, e - src + 1)) return str;
+			src = e + 1;
+			continue;
+		}
+		type = _v_get(v, &data, NULL);
+		sv = _v_str(type, data);
+		if (!sv) sv = var_empty_string;
+		if (_v_buf_add(&b, src, e - src) || _v_buf_add(&b, sv, strlen(sv))) return str;
+		src = e + 1 + v->keylen;
+	}
+	if (_v_buf_add(&b, src, strlen(src))) return str;
+
+	return b.len > 0 ? b.p : var_empty_string;
+}
+
+
+/******************************************************************************/
+/**
+ * Initialize variable library.
+ * Returns 0 also, if init function already called.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+int var_init(void)
+{
+	int i;
+
+	/* Dont init, if already init. */
+	if (_v_lists() > 0) return 0;
+
+	/* Allocate first chunk of lists, it holds the default list. */
+	var_list[0] = (struct var_list *)malloc(VAR_LIST_SIZE * VAR_LIST_CHUNK_MIN);
+	if (!var_list[0]) return -1;
+	memset(var_list[0], 0, VAR_LIST_SIZE * VAR_LIST_CHUNK_MIN);
+	var_list[0][0].name_next = -1;
+	
+	if (lock_init(&var_list_lock))
+	{
+		free(var_list[0]);
+		var_list[0] = NULL;
+		return -1;
+	}
+	if (lock_init(&var_list[0][0].lock))
+	{
+		lock_destroy(&var_list_lock);
+		free(var_list[0]);
+		var_list[0] = NULL;
+		return -1;
+	}
+	if (lock_init(&var_watch_lock))
+	{
+		lock_destroy(&var_list[0][0].lock);
+		lock_destroy(&var_list_lock);
+		free(var_list[0]);
+		var_list[0] = NULL;
+		return -1;
+	}
+	memset(var_keys, 0, sizeof(var_keys));
+	for (i = 0; i < VAR_KEYS_STRIPES; i++)
+	{
+		var_keys[i].name_next = -1;
+		var_keys[i].id = -1;
+		var_keys[i].flags = VAR_LIST_LOCAL | VAR_LIST_INDEX;
+		if (lock_init(&var_keys[i].lock)) break;
+	}
+	if (i < VAR_KEYS_STRIPES)
+	{
+		while (i-- > 0) lock_destroy(&var_keys[i].lock);
+		lock_destroy(&var_watch_lock);
+		lock_destroy(&var_list[0][0].lock);
+		lock_destroy(&var_list_lock);
+		free(var_list[0]);
+		var_list[0] = NULL;
+		return -1;
+	}
+	var_keys_lost = 0;
+
+	__atomic_store_n(&var_list_c, 1, __ATOMIC_RELEASE);
+	
+	return 0;
+}
+
+
+/******************************************************************************/
+/** Quit using this library. */
+void var_quit(void)
+{
+	struct var_reader *r;
+	int i;
+
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return;
+
+	lock_write(&var_watch_lock);
+	while (var_watch_c > 0) _v_watch_free(&var_watches[--var_watch_c]);
+	if (var_watches) free(var_watches);
+	var_watches = NULL;
+	var_watch_size = 0;
+	if (var_watch_inotify > -1) close(var_watch_inotify);
+	var_watch_inotify = -1;
+	lock_unlock(&var_watch_lock);
+	lock_destroy(&var_watch_lock);
+	
+	_v_lock_write(&var_list_lock, &var_stat_list_lock_wait);
+
+	for (i = 0; i < var_list_c; i++)
+	{
+		_v_clear(_v_list(i));
+		_v_retire_flush_to(&_v_list(i)->retired, &_v_list(i)->retired_c, &_v_list(i)->retired_size);
+		lock_destroy(&_v_list(i)->lock);
+	}
+	for (i = 0; i < VAR_KEYS_STRIPES; i++)
+	{
+		_v_clear(&var_keys[i]);
+		_v_retire_flush_to(&var_keys[i].retired, &var_keys[i].retired_c, &var_keys[i].retired_size);
+		lock_destroy(&var_keys[i].lock);
+	}
+	for (r = var_readers; r; r = r->next)
+	{
+		_v_retire_flush_to(&r->retired, &r->retired_c, &r->retired_size);
+		if (r->overlay)
+		{
+			_v_clear(r->overlay);
+			_v_retire_flush_to(&r->overlay->retired, &r->overlay->retired_c, &r->overlay->retired_size);
+			free(r->overlay);
+			r->overlay = NULL;
+		}
+		if (r->shadow) free(r->shadow);
+		r->shadow = NULL;
+		r->shadow_c = 0;
+		r->shadow_size = 0;
+	}
+	
+	for (i = 0; i < VAR_LIST_CHUNKS; i++)
+	{
+		if (var_list[i]) free(var_list[i]);
+		var_list[i] = NULL;
+	}
+	__atomic_store_n(&var_list_c, 0, __ATOMIC_RELEASE);
+	if (var_list_names) free(var_list_names);
+	var_list_names = NULL;
+	var_list_names_size = 0;
+	
+	lock_unlock(&var_list_lock);
+	lock_destroy(&var_list_lock);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Allocate zeroed and aligned space from end of
+ * snapshot being built.
+ *
+ * @return Offset of space, or -1 on errors.
+ */
+static size_t _v_snap_alloc(struct var_buf *b, size_t n)
+{
+	size_t off = (b->len + VAR_ARENA_ALIGN - 1) & ~((size_t)VAR_ARENA_ALIGN - 1), size;
+	char *p;
+
+	if (off + n >= b->size)
+	{
+		size = b->size ? b->size : VAR_ARENA_BLOCK_SIZE;
+		while (size <= off + n) size *= 2;
+		p = (char *)realloc(b->p, size);
+		if (!p) return (size_t)-1;
+		b->p = p;
+		b->size = size;
+	}
+	memset(&b->p[b->len], 0, off + n - b->len);
+	b->len = off + n;
+
+	return off;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add prefix tree to snapshot being built.
+ * Children and siblings are added before node, so their addresses are
+ * known when node is added.
+ *
+ * @return Address of node in snapshot, NULL if tree is empty, or -1 on errors.
+ */
+static uintptr_t _v_snap_trie(struct var_buf *b, struct var_trie *t)
+{
+	uintptr_t child, next;
+	struct var_trie *n;
+	size_t off;
+
+	if (!t) return 0;
+	child = _v_snap_trie(b, t->child);
+	next = _v_snap_trie(b, t->next);
+	if (child == (uintptr_t)-1 || next == (uintptr_t)-1) return (uintptr_t)-1;
+	off = _v_snap_alloc(b, sizeof(*t) + t->len);
+	if (off == (size_t)-1) return (uintptr_t)-1;
+
+	n = (struct var_trie *)&b->p[off];
+	n->child = (struct var_trie *)child;
+	n->next = (struct var_trie *)next;
+	n->item = t->item;
+	n->len = t->len;
+	memcpy(n->label, t->label, t->len);
+
+	return VAR_SNAPSHOT_BASE + off;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Add list to snapshot being built.
+ * Items visible in list are stored as they are in memory, pointers are
+ * set to point where items will be when snapshot is mapped to
+ * VAR_SNAPSHOT_BASE.
+ * @note Read locks list.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_snap_list(struct var_buf *b, var_list_t list)
+{
+	struct var_list *l = _v_list(list);
+	struct var_snapshot_list *sl;
+	struct var_layer *layer;
+	struct var_item *v, *w, **hash;
+	struct var_trie *trie = NULL;
+	struct var_tmpl *t;
+	size_t *off = NULL, count, hash_size, hoff, doff, n, tn, i, j;
+	uintptr_t a;
+	int err = 0;
+
+	_v_lock_read(&l->lock, &l->stats.lock_wait_ns);
+
+	count = l->count;
+	off = (size_t *)malloc(sizeof(*off) * (count + 1));
+	if (!off) goto out_err;
+
+	for (i = 0, v = _v_next(l, &layer, NULL); v && i < count; v = _v_next(l, &layer, v), i++)
+	{
+		off[i] = _v_snap_alloc(b, VAR_ITEM_ALLOC(v->keylen));
+		if (off[i] == (size_t)-1) goto out_err;
+		w = (struct var_item *)&b->p[off[i]];
+		memcpy(w, v, VAR_ITEM_ALLOC(v->keylen));
+		w->flags = 0;
+		w->seq = 0;
+		w->memo = NULL;
+		w->data = NULL;
+		w->tmpl = NULL;
+		if (!v->data) continue;
+
+		/*
+		 * String and its template are in same buffer, see _v_set().
+		 * Buffer given to item may end right at size, so null after
+		 * value comes from zeroed snapshot.
+		 */
+		n = v->size;
+		if (v->tmpl)
+		{
+			tn = _v_tmpl_scan(v->data, strnlen(v->data, v->size), NULL, &j);
+			n = ((char *)v->tmpl - (char *)v->data) + tn;
+		}
+		doff = _v_snap_alloc(b, n > v->size ? n : v->size + 1);
+		if (doff == (size_t)-1) goto out_err;
+		memcpy(&b->p[doff], v->data, n);
+		w = (struct var_item *)&b->p[off[i]];
+		w->data = (void *)(VAR_SNAPSHOT_BASE + doff);
+		if (VAR_TYPE_IS_NUM(v->type)) ((struct var_num *)&b->p[doff])->str = NULL;
+		if (!v->tmpl) continue;
+
+		a = VAR_SNAPSHOT_BASE + doff - (uintptr_t)v->data;
+		w->tmpl = (struct var_tmpl *)((uintptr_t)v->tmpl + a);
+		t = (struct var_tmpl *)&b->p[doff + ((char *)v->tmpl - (char *)v->data)];
+		for (j = 0; j < t->count; j++)
+		{
+			t->tok[j].str = (const char *)((uintptr_t)t->tok[j].str + a);
+			t->tok[j].cache_seq = 0;
+			t->tok[j].cache_list = -2;
+			t->tok[j].cache_version = 0;
+			t->tok[j].cache_key_version = 0;
+			t->tok[j].cache_item = NULL;
+		}
+	}
+	count = i;
+
+	/* Hash index and order of items. */
+	for (hash_size = VAR_HASH_MIN_SIZE; hash_size < count; hash_size *= 2);
+	hoff = _v_snap_alloc(b, sizeof(*hash) * hash_size);
+	if (hoff == (size_t)-1) goto out_err;
+	hash = (struct var_item **)&b->p[hoff];
+	for (i = 0; i < count; i++)
+	{
+		w = (struct var_item *)&b->p[off[i]];
+		w->prev = i > 0 ? (struct var_item *)(VAR_SNAPSHOT_BASE + off[i - 1]) : NULL;
+		w->next = i + 1 < count ? (struct var_item *)(VAR_SNAPSHOT_BASE + off[i + 1]) : NULL;
+		w->hash_next = hash[w->hash & (hash_size - 1)];
+		hash[w->hash & (hash_size - 1)] = (struct var_item *)(VAR_SNAPSHOT_BASE + off[i]);
+	}
+
+	/* Prefix tree, built with addresses of items in snapshot. */
+	for (i = 0; i < count; i++)
+	{
+		w = (struct var_item *)&b->p[off[i]];
+		if (_v_trie_add(&trie, w->key, (struct var_item *)(VAR_SNAPSHOT_BASE + off[i]))) goto out_err;
+	}
+	a = _v_snap_trie(b, trie);
+	if (a == (uintptr_t)-1) goto out_err;
+
+	sl = (struct var_snapshot_list *)&b->p[sizeof(struct var_snapshot_head) + sizeof(*sl) * list];
+	memcpy(sl->name, l->name, sizeof(sl->name));
+	sl->flags = l->flags;
+	sl->count = count;
+	sl->first = count > 0 ? (struct var_item *)(VAR_SNAPSHOT_BASE + off[0]) : NULL;
+	sl->hash = (struct var_item **)(VAR_SNAPSHOT_BASE + hoff);
+	sl->hash_size = hash_size;
+	sl->trie = (struct var_trie *)a;
+	goto out;
+
+out_err:
+	err = -1;
+out:
+	lock_unlock(&l->lock);
+	_v_trie_free(trie);
+	if (off) free(off);
+	return err;
+}
+
+
+/******************************************************************************/
+int var_save_snapshot(const char *file)
+{
+	struct var_snapshot_head *h;
+	struct var_buf b = { 0 };
+	FILE *f = NULL;
+	int i, n, err = 0;
+
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1 || !file) return -1;
+
+	/* Header and lists are first. */
+	n = _v_lists();
+	if (_v_snap_alloc(&b, sizeof(*h) + sizeof(struct var_snapshot_list) * n) == (size_t)-1) goto out_err;
+	for (i = 0; i < n; i++)
+	{
+		if (_v_snap_list(&b, i)) goto out_err;
+	}
+
+	h = (struct var_snapshot_head *)b.p;
+	memcpy(h->magic, VAR_SNAPSHOT_MAGIC, sizeof(VAR_SNAPSHOT_MAGIC));
+	h->version = VAR_SNAPSHOT_VERSION;
+	h->lists = n;
+	h->ptr_size = sizeof(void *);
+	h->item_size = VAR_ITEM_SIZE;
+	h->base = VAR_SNAPSHOT_BASE;
+	h->size = b.len;
+
+	f = fopen(file, "wb");
+	if (!f) goto out_err;
+	if (fwrite(b.p, 1, b.len, f) != b.len) goto out_err;
+	if (fclose(f)) err = -1;
+	f = NULL;
+	goto out;
+
+out_err:
+	err = -1;
+out:
+	if (f) fclose(f);
+	if (b.p) free(b.p);
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Get address in mapped snapshot of object saved
+ * to snapshot.
+ *
+ * @param map Mapped snapshot.
+ * @param size Size of mapping.
+ * @param p Address of object in snapshot file.
+ * @param n Size of object.
+ * @param align Required alignment of object.
+ *
+ * @return Address of object, or NULL if object is not fully inside
+ *         snapshot or is not aligned.
+ */
+static void *_v_snap_ptr(void *map, size_t size, const void *p, size_t n, size_t align)
+{
+	uintptr_t off = (uintptr_t)p - VAR_SNAPSHOT_BASE;
+
+	if ((uintptr_t)p < VAR_SNAPSHOT_BASE || off > size || n > size - off || off % align) return NULL;
+
+	return (char *)map + off;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check prefix tree of list in snapshot.
+ * Items of nodes must be items of list, see _v_snap_check().
+ *
+ * @param len Length of key so far.
+ * @param max Length of longest key in list.
+ * @param nodes Count of nodes that still fit to snapshot.
+ *
+ * @return 0 if tree is valid, -1 if not.
+ */
+static int _v_snap_check_trie(void *map, size_t size, struct var_trie *t, size_t len, size_t max, size_t *nodes)
+{
+	struct var_trie *n;
+	struct var_item *v;
+
+	for ( ; t; t = n->next)
+	{
+		n = (struct var_trie *)_v_snap_ptr(map, size, t, sizeof(*n), VAR_ARENA_ALIGN);
+		if (!n || *nodes == 0 || n->len < 1 || n->len > max - len) return -1;
+		if (!_v_snap_ptr(map, size, t, sizeof(*n) + n->len, VAR_ARENA_ALIGN)) return -1;
+		(*nodes)--;
+		if (n->item)
+		{
+			v = (struct var_item *)_v_snap_ptr(map, size, n->item, VAR_ITEM_SIZE, VAR_ARENA_ALIGN);
+			if (!v || !(v->flags & VAR_ITEM_SNAP_LIST) || v->keylen != len + n->len) return -1;
+		}
+		if (_v_snap_check_trie(map, size, n->child, len + n->len, max, nodes)) return -1;
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Check list in snapshot before it is used.
+ * Every pointer must point inside snapshot, items must form chain of
+ * list count items, hash index and prefix tree must only have items of
+ * the chain. Items may not be shared with other lists. State that is
+ * only valid in memory of saving process is reset.
+ *
+ * @return 0 if list is valid, -1 if not.
+ */
+static int _v_snap_check(void *map, size_t size, struct var_snapshot_list *sl)
+{
+	struct var_item *p, *v, *w, **hash;
+	struct var_tmpl *t;
+	struct var_num *n;
+	size_t i, j, max = 0, nodes = size / sizeof(struct var_trie);
+
+	if (!memchr(sl->name, 0, sizeof(sl->name)) || (sl->flags & ~(VAR_LIST_ARENA | VAR_LIST_ARRAY))) return -1;
+
+	/* Chain of items and their values. */
+	for (i = 0, p = NULL, v = sl->first; v; p = v, v = w->next, i++)
+	{
+		w = (struct var_item *)_v_snap_ptr(map, size, v, VAR_ITEM_SIZE, VAR_ARENA_ALIGN);
+		if (!w || i >= sl->count || w->prev != p || w->flags) return -1;
+		if (w->keylen >= size || !_v_snap_ptr(map, size, v, VAR_ITEM_ALLOC(w->keylen), VAR_ARENA_ALIGN)) return -1;
+		if (w->key[w->keylen] || w->type < VAR_TYPE_EMPTY || w->type > VAR_TYPE_INT) return -1;
+		w->flags = VAR_ITEM_SNAP_LIST;
+		w->seq = 0;
+		w->memo = NULL;
+		w->small_epoch = 0;
+		if (w->keylen > max) max = w->keylen;
+		if (!w->data)
+		{
+			if (w->tmpl) return -1;
+			continue;
+		}
+
+		/*
+		 * Values are saved with terminating null right after their items,
+		 * see _v_snap_list(), so items can not share values.
+		 */
+		if ((char *)w->data != (char *)v + ((VAR_ITEM_ALLOC(w->keylen) + VAR_ARENA_ALIGN - 1) & ~((size_t)VAR_ARENA_ALIGN - 1))) return -1;
+		if (w->size >= size || !_v_snap_ptr(map, size, w->data, w->size + 1, 1)) return -1;
+		if (w->type == VAR_TYPE_STR && ((char *)_v_snap_ptr(map, size, w->data, w->size + 1, 1))[w->size]) return -1;
+		if (VAR_TYPE_IS_NUM(w->type))
+		{
+			n = (struct var_num *)_v_snap_ptr(map, size, w->data, sizeof(*n), VAR_ARENA_ALIGN);
+			if (!n || w->size != sizeof(*n)) return -1;
+			n->str = NULL;
+		}
+		if (!w->tmpl) continue;
+
+		t = (struct var_tmpl *)_v_snap_ptr(map, size, w->tmpl, sizeof(*t), VAR_ARENA_ALIGN);
+		if (!t || w->type != VAR_TYPE_STR || (char *)w->tmpl <= (char *)w->data + w->size) return -1;
+		if (t->count > size / sizeof(t->tok[0])) return -1;
+		if (!_v_snap_ptr(map, size, w->tmpl, sizeof(*t) + sizeof(t->tok[0]) * t->count, VAR_ARENA_ALIGN)) return -1;
+		for (j = 0; j < t->count; j++)
+		{
+			if (!_v_snap_ptr(map, size, t->tok[j].str, t->tok[j].len, 1)) return -1;
+			t->tok[j].cache_seq = 0;
+			t->tok[j].cache_list = -2;
+			t->tok[j].cache_version = 0;
+			t->tok[j].cache_key_version = 0;
+			t->tok[j].cache_item = NULL;
+		}
+	}
+	if (i != sl->count) return -1;
+
+	/* Hash index must have every item once, in its own slot. */
+	if (sl->hash_size < 1 || (sl->hash_size & (sl->hash_size - 1)) || sl->hash_size > size / sizeof(*hash)) return -1;
+	hash = (struct var_item **)_v_snap_ptr(map, size, sl->hash, sizeof(*hash) * sl->hash_size, VAR_ARENA_ALIGN);
+	if (!hash) return -1;
+	for (i = 0; i < sl->hash_size; i++)
+	{
+		for (v = hash[i]; v; v = w->hash_next)
+		{
+			w = (struct var_item *)_v_snap_ptr(map, size, v, VAR_ITEM_SIZE, VAR_ARENA_ALIGN);
+			if (!w || w->flags != VAR_ITEM_SNAP_LIST || (w->hash & (sl->hash_size - 1)) != i) return -1;
+			w->flags |= VAR_ITEM_SNAP_HASH;
+		}
+	}
+	for (v = sl->first; v; v = w->next)
+	{
+		w = (struct var_item *)_v_snap_ptr(map, size, v, VAR_ITEM_SIZE, VAR_ARENA_ALIGN);
+		if (!(w->flags & VAR_ITEM_SNAP_HASH)) return -1;
+	}
+
+	if (_v_snap_check_trie(map, size, sl->trie, 0, max, &nodes)) return -1;
+
+	/* Items stay marked, so that lists checked later can not use them. */
+	for (v = sl->first; v; v = w->next)
+	{
+		w = (struct var_item *)_v_snap_ptr(map, size, v, VAR_ITEM_SIZE, VAR_ARENA_ALIGN);
+		w->flags = VAR_ITEM_SNAP_DONE;
+	}
+
+	return 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Move pointers of prefix tree in snapshot.
+ */
+static void _v_snap_move_trie(struct var_trie *t, intptr_t d)
+{
+	for ( ; t; t = t->next)
+	{
+		if (t->next) t->next = (struct var_trie *)((char *)t->next + d);
+		if (t->child) t->child = (struct var_trie *)((char *)t->child + d);
+		if (t->item) t->item = (struct var_item *)((char *)t->item + d);
+		_v_snap_move_trie(t->child, d);
+	}
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Move pointers of list in snapshot, when snapshot
+ * could not be mapped to address it was saved for.
+ */
+static void _v_snap_move(struct var_snapshot_list *sl, intptr_t d)
+{
+	struct var_item *v;
+	size_t i;
+
+#define VAR_SNAP_MOVE(p) if (p) (p) = (void *)((char *)(p) + d)
+	VAR_SNAP_MOVE(sl->first);
+	VAR_SNAP_MOVE(sl->hash);
+	VAR_SNAP_MOVE(sl->trie);
+	for (i = 0; i < sl->hash_size; i++) VAR_SNAP_MOVE(sl->hash[i]);
+	for (v = sl->first; v; v = v->next)
+	{
+		VAR_SNAP_MOVE(v->next);
+		VAR_SNAP_MOVE(v->prev);
+		VAR_SNAP_MOVE(v->hash_next);
+		VAR_SNAP_MOVE(v->data);
+		VAR_SNAP_MOVE(v->tmpl);
+		for (i = 0; v->tmpl && i < v->tmpl->count; i++) VAR_SNAP_MOVE(v->tmpl->tok[i].str);
+	}
+#undef VAR_SNAP_MOVE
+	_v_snap_move_trie(sl->trie, d);
+}
+
+
+/******************************************************************************/
+int var_load_snapshot(const char *file)
+{
+	struct var_snapshot_head *h;
+	struct var_snapshot_list *sl;
+	struct var_image *image;
+	struct var_layer *layer;
+	struct var_item *v;
+	struct var_list *l;
+	struct stat st;
+	var_list_t list;
+	void *map;
+	uint32_t i;
+	int fd, err = 0;
+
+	/* Return error, if lib not initialized yet, or lists would be cleared while iterated. */
+	if (_v_lists() < 1 || !file || _v_iterating(NULL)) return -1;
+
+	/* Map file, preferably to address it was saved for. */
+	fd = open(file, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*h))
+	{
+		close(fd);
+		return -1;
+	}
+	map = mmap((void *)VAR_SNAPSHOT_BASE, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -1;
+
+	h = (struct var_snapshot_head *)map;
+	if (memcmp(h->magic, VAR_SNAPSHOT_MAGIC, sizeof(VAR_SNAPSHOT_MAGIC)) ||
+	    h->version != VAR_SNAPSHOT_VERSION || h->ptr_size != sizeof(void *) ||
+	    h->item_size != VAR_ITEM_SIZE || h->base != VAR_SNAPSHOT_BASE ||
+	    h->size != (uint64_t)st.st_size || sizeof(*h) + sizeof(*sl) * (uint64_t)h->lists > h->size)
+	{
+		munmap(map, st.st_size);
+		return -1;
+	}
+	for (i = 0; i < h->lists; i++)
+	{
+		sl = (struct var_snapshot_list *)((char *)map + sizeof(*h) + sizeof(*sl) * i);
+		if (_v_snap_check(map, st.st_size, sl))
+		{
+			munmap(map, st.st_size);
+			return -1;
+		}
+	}
+
+	image = (struct var_image *)malloc(sizeof(*image));
+	if (!image)
+	{
+		munmap(map, st.st_size);
+		return -1;
+	}
+	image->map = map;
+	image->size = st.st_size;
+	image->refs = h->lists + 1;
+
+	for (i = 0; i < h->lists; i++)
+	{
+		sl = (struct var_snapshot_list *)((char *)map + sizeof(*h) + sizeof(*sl) * i);
+		if ((uintptr_t)map != VAR_SNAPSHOT_BASE) _v_snap_move(sl, (intptr_t)((uintptr_t)map - VAR_SNAPSHOT_BASE));
+		for (v = sl->first; v; v = v->next) v->flags = 0;
+
+		/* Default list is always first, other unnamed lists are created. */
+		if (i == 0) list = 0;
+		else if (sl->name[0]) list = varl_new_flags(sl->name, sl->flags);
+		else list = varl_new_flags(NULL, sl->flags);
+		layer = list > -1 ? (struct var_layer *)malloc(sizeof(*layer)) : NULL;
+		if (!layer)
+		{
+			__atomic_sub_fetch(&image->refs, 1, __ATOMIC_ACQ_REL);
+			err = -1;
+			continue;
+		}
+		layer->first = sl->first;
+		layer->hash = sl->hash;
+		layer->hash_size = sl->hash_size;
+		layer->trie = sl->trie;
+		layer->arena = NULL;
+		layer->image = image;
+		layer->base = NULL;
+		layer->depth = 1;
+		layer->refs = 1;
+
+		l = _v_list(list);
+		_v_lock_write(&l->lock, &l->stats.lock_wait_ns);
+		_v_keys_list(l, 0);
+		_v_clear(l);
+		__atomic_store_n(&l->base, layer, __ATOMIC_RELEASE);
+		l->count = sl->count;
+		_v_keys_list(l, 1);
+		__atomic_add_fetch(&var_items_version, 1, __ATOMIC_RELEASE);
+		_v_slot_list(l);
+		lock_unlock(&l->lock);
+	}
+
+	/* Release reference held while restoring. */
+	if (__atomic_sub_fetch(&image->refs, 1, __ATOMIC_ACQ_REL) == 0)
+	{
+		munmap(map, st.st_size);
+		free(image);
+	}
+
+	return err;
+}
+
+
+/******************************************************************************/
+/** Dump debug info about contents of lists and their variables. */
+void var_dump(void)
+{
+	struct var_item *v;
+	struct var_layer *layer;
+	int i, j, n;
+	char *type, *str, content[MAX_STRING];
+
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1)
+	{
+		printf("library is empty\n");
+		return;
+	}
+	
+	for (i = 0, n = _v_lists(); i < n; i++)
+	{
+		_v_lock_read(&_v_list(i)->lock, &_v_list(i)->stats.lock_wait_ns);
+		printf("** %d. printing items in list (name \'%s\', item count %d)\n", (int)i, _v_list(i)->name, (int)_v_list(i)->count);
+		for (j = 0, v = _v_next(_v_list(i), &layer, NULL); v; v = _v_next(_v_list(i), &layer, v), j++)
+		{
+			switch (v->type)
+			{
+			case VAR_TYPE_EMPTY:
+				type = "empty";
+				break;
+			case VAR_TYPE_STR:
+				type = "ascii";
+				break;
+			case VAR_TYPE_NUM:
+				type = "number";
+				break;
+			case VAR_TYPE_INT:
+				type = "integer";
+				break;
+			case VAR_TYPE_BIN:
+				type = "binary";
+				break;
+			}
+			
+			str = _v_str(v->type, v->data);
+			if (!str) str = v->data ? v->data : var_empty_string;
+			memset(content, 0, sizeof(content));
+			strncpy(content, str, 20);
+			if (strlen(str) > strlen(content)) strcat(content, "...");
+			printf("    %d. name \'%s\', type \'%s\', size %d, content \'%s\'\n", (int)j, v->key, type, (int)v->size, content);
+		}
+		lock_unlock(&_v_list(i)->lock);
+	}
+}
+
+
+/******************************************************************************/
+int varl_stats(var_list_t list, struct var_list_stats *stats)
+{
+#ifdef VAR_STATS
+	struct var_list *l;
+#endif
+
+	memset(stats, 0, sizeof(*stats));
+#ifdef VAR_STATS
+	if (list < 0 || list >= _v_lists()) return -1;
+	l = _v_list(list);
+	stats->gets = __atomic_load_n(&l->stats.gets, __ATOMIC_RELAXED);
+	stats->misses = __atomic_load_n(&l->stats.misses, __ATOMIC_RELAXED);
+	stats->sets = __atomic_load_n(&l->stats.sets, __ATOMIC_RELAXED);
+	stats->scanned = __atomic_load_n(&l->stats.scanned, __ATOMIC_RELAXED);
+	stats->lock_wait_ns = __atomic_load_n(&l->stats.lock_wait_ns, __ATOMIC_RELAXED);
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+
+/******************************************************************************/
+int var_stats(struct var_stats *stats)
+{
+#ifdef VAR_STATS
+	struct var_list_stats ls;
+	int i;
+#endif
+
+	memset(stats, 0, sizeof(*stats));
+#ifdef VAR_STATS
+	if (_v_lists() < 1) return -1;
+	for (stats->lists = _v_lists(), i = 0; i < stats->lists; i++)
+	{
+		varl_stats(i, &ls);
+		stats->total.gets += ls.gets;
+		stats->total.misses += ls.misses;
+		stats->total.sets += ls.sets;
+		stats->total.scanned += ls.scanned;
+		stats->total.lock_wait_ns += ls.lock_wait_ns;
+	}
+	stats->expands = __atomic_load_n(&var_stat_expands, __ATOMIC_RELAXED);
+	stats->memo_hits = __atomic_load_n(&var_stat_memo_hits, __ATOMIC_RELAXED);
+	stats->list_lock_wait_ns = __atomic_load_n(&var_stat_list_lock_wait, __ATOMIC_RELAXED);
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+
+/******************************************************************************/
+void var_stats_reset(void)
+{
+	struct var_list *l;
+	int i, n;
+
+	for (i = 0, n = _v_lists(); i < n; i++)
+	{
+		l = _v_list(i);
+		__atomic_store_n(&l->stats.gets, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->stats.misses, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->stats.sets, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->stats.scanned, 0, __ATOMIC_RELAXED);
+		__atomic_store_n(&l->stats.lock_wait_ns, 0, __ATOMIC_RELAXED);
+	}
+	__atomic_store_n(&var_stat_expands, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&var_stat_memo_hits, 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&var_stat_list_lock_wait, 0, __ATOMIC_RELAXED);
+}
+
+
+/******************************************************************************/
+void var_dump_stats(void)
+{
+	struct var_list_stats ls;
+	struct var_stats st;
+	int i;
+
+	if (var_stats(&st))
+	{
+		printf("stats=disabled\n");
+		return;
+	}
+
+	printf("stats=total lists=%d gets=%llu misses=%llu sets=%llu scanned=%llu lock_wait_ns=%llu "
+	       "expands=%llu memo_hits=%llu list_lock_wait_ns=%llu\n",
+	       st.lists, (unsigned long long)st.total.gets, (unsigned long long)st.total.misses,
+	       (unsigned long long)st.total.sets, (unsigned long long)st.total.scanned,
+	       (unsigned long long)st.total.lock_wait_ns, (unsigned long long)st.expands,
+	       (unsigned long long)st.memo_hits, (unsigned long long)st.list_lock_wait_ns);
+	for (i = 0; i < st.lists; i++)
+	{
+		varl_stats(i, &ls);
+		/* Name is last, since it can have spaces. */
+		printf("stats=list list=%d items=%d gets=%llu misses=%llu sets=%llu scanned=%llu lock_wait_ns=%llu name=%s\n",
+		       i, (int)__atomic_load_n(&_v_list(i)->count, __ATOMIC_RELAXED),
+		       (unsigned long long)ls.gets, (unsigned long long)ls.misses, (unsigned long long)ls.sets,
+		       (unsigned long long)ls.scanned, (unsigned long long)ls.lock_wait_ns, _v_list(i)->name);
+	}
+}
+
+
+/******************************************************************************/
+/**
+ * Allocate new item in variables.
+ * @param name Optional name for new variable list. Can be NULL.
+ * @return Index of new list or -1 on errors.
+ */
+var_list_t varl_new(char *name)
+{
+	return varl_new_flags(name, 0);
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Create new list.
+ * Name is checked and list created under same lock, so only one caller
+ * can create list with given name.
+ *
+ * @param exclusive If set, fail when list with same name exists, else
+ *                  return existing list.
+ * @return Index of list or -1 on errors.
+ */
+static var_list_t _v_list_new(const char *name, int flags, int exclusive)
+{
+	unsigned int k;
+	size_t size;
+	var_list_t list = -1;
+	struct var_list *l;
+	
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+
+	_v_lock_write(&var_list_lock, &var_stat_list_lock_wait);
+
+	/* check for existing list with this name */
+	if (name)
+	{
+		list = name[0] ? _v_names_find(name) : 0;
+		if (list > -1)
+		{
+			if (exclusive) list = -1;
+			goto out_err;
+		}
+	}
+	
+	/* Allocate new chunk for lists if needed, old chunks never move. */
+	k = 31 - __builtin_clz((unsigned int)var_list_c / VAR_LIST_CHUNK_MIN + 1);
+	if (k >= VAR_LIST_CHUNKS) goto out_err;
+	if (!var_list[k])
+	{
+		size = VAR_LIST_SIZE * ((size_t)VAR_LIST_CHUNK_MIN << k);
+		var_list[k] = (struct var_list *)malloc(size);
+		if (!var_list[k]) goto out_err;
+		memset(var_list[k], 0, size);
+	}
+	
+	/* Setup new item. */
+	l = _v_list(var_list_c);
+	memset(l, 0, VAR_LIST_SIZE);
+	if (name) STRCPY(l->name, name);
+	l->id = var_list_c;
+	l->flags = flags & ~(VAR_LIST_LOCAL | VAR_LIST_INDEX);
+	if (lock_init(&l->lock)) goto out_err;
+	if (_v_names_add(var_list_c))
+	{
+		lock_destroy(&l->lock);
+		goto out_err;
+	}
+	
+	/* Publish new list only after it is fully initialized. */
+	list = var_list_c;
+	__atomic_store_n(&var_list_c, var_list_c + 1, __ATOMIC_RELEASE);
+
+out_err:
+	lock_unlock(&var_list_lock);
+	return list;
+}
+
+
+/******************************************************************************/
+var_list_t varl_new_flags(char *name, int flags)
+{
+	return _v_list_new(name, flags, 0);
+}
+
+
+/******************************************************************************/
+/**
+ * Find variable list with its name. This function can be used to find only
+ * named lists. If named list is not found, default list 0 is returned.
+ * Default list has no name, so either caller can use returned group number
+ * without caring whether right list is found or detect unfound list from
+ * return value 0.
+ *
+ * @param name Name of list given when calling varl_new().
+ * @return Index of item found or -1 if not found.
+ */
+var_list_t varl_find(char *name)
+{
+	var_list_t i;
+	
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+	/* Return first list, if no name is given. */
+	if (!name) return -1;
+	if (strlen(name) < 1) return 0;
+	
+	_v_lock_read(&var_list_lock, &var_stat_list_lock_wait);
+	i = _v_names_find(name);
+	lock_unlock(&var_list_lock);
+
+	return i;
+}
+
+
+/******************************************************************************/
+int varl_rename(var_list_t list, char *name)
+{
+	int err = 0;
+
+	if (_v_lists() < 1 || !name) return -1;
+	if (list >= _v_lists() || list < 0) return -1;
+	_v_lock_write(&var_list_lock, &var_stat_list_lock_wait);
+	_v_names_rm(list);
+	STRCPY(_v_list(list)->name, name);
+	err = _v_names_add(list);
+	lock_unlock(&var_list_lock);
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Set variable as ascii string.
+ * This function searches, if item within this name is already found,
+ * and replaces it, or creates new one if old not found.
+ * List ID should be some of following:
+ * 0 which is default list, list ID returned by varl_new() (>0),
+ * or -1 which means all lists. If -1 is defined, then all lists are searched
+ * for occurenses of name and data for all found items is set to given.
+ * In this case (-1), no new items are created in lists.
+ *
+ * @param list ID of list to be used returned by varl_new().
+ *             0 can be used as default list, and it is always 
+ *             available after var_init() has been called.
+ *             See more from description.
+ * @param name Name of item to be set.
+ * @param string printf() style formatted string and arguments following.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_str(var_list_t list, char *name, char *string, ...)
+{
+	int size, err;
+	va_list args;
+	char *newstr = NULL;
+
+	/* Format given ascii data. */
+	va_start(args, string);
+	size = vasprintf(&newstr, string, args);
+	va_end(args);
+	if (size < 0) return -1;
+	size++; /* Include terminating null char in size. */
+	
+	/* Go trough requested lists, formatted string is given to item. */
+	err = _v_list_set_own(list, name, newstr, size, VAR_TYPE_STR);
+
+	return err;
+}
+
+
+/******************************************************************************/
+int varl_set_str_own(var_list_t list, const char *name, char *string)
+{
+	if (!string) return -1;
+	return _v_list_set_own(list, name, string, strlen(string) + 1, VAR_TYPE_STR);
+}
+
+
+/******************************************************************************/
+int varl_set_str_own_n(var_list_t list, const char *name, char *string, size_t len)
+{
+	if (!string) return -1;
+	return _v_list_set_own(list, name, string, len, VAR_TYPE_STR);
+}
+
+
+/******************************************************************************/
+/**
+ * As varl_set_str, but set variable as number.
+ * Number is stored as is, so varl_get_num() and varl_get_int() do not
+ * need to parse it. String form is made only when asked.
+ *
+ * @param list ID of list to be used.
+ * @param name Name of item to be set.
+ * @param num Number to be set.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_num(var_list_t list, char *name, double num)
+{
+	struct var_num n;
+
+	/* Number is stored as is, string form is formatted when needed. */
+	memset(&n, 0, sizeof(n));
+	n.num = num;
+	n.i = (int)num;
+
+	return _v_list_set(list, name, &n, sizeof(n), VAR_TYPE_NUM);
+}
+
+
+/******************************************************************************/
+/**
+ * As varl_set_num, but set variable as integer number, not double.
+ *
+ * @param list ID of list to be used.
+ * @param name Name of item to be set.
+ * @param num Number to be set.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_int(var_list_t list, char *name, int num)
+{
+	struct var_num n;
+
+	memset(&n, 0, sizeof(n));
+	n.num = (double)num;
+	n.i = num;
+
+	return _v_list_set(list, name, &n, sizeof(n), VAR_TYPE_INT);
+}
+
+
+/******************************************************************************/
+int varl_append_str(var_list_t list, const char *string, ...)
+{
+	int size, index;
+	va_list args;
+	char *newstr = NULL;
+
+	va_start(args, string);
+	size = vasprintf(&newstr, string, args);
+	va_end(args);
+	if (size < 0) return -1;
+
+	index = _v_at_set(list, -1, newstr, size + 1, VAR_TYPE_STR);
+	free(newstr);
+
+	return index;
+}
+
+
+/******************************************************************************/
+int varl_append_num(var_list_t list, double num)
+{
+	struct var_num n;
+
+	memset(&n, 0, sizeof(n));
+	n.num = num;
+	n.i = (int)num;
+
+	return _v_at_set(list, -1, &n, sizeof(n), VAR_TYPE_NUM);
+}
+
+
+/******************************************************************************/
+int varl_append_int(var_list_t list, int num)
+{
+	struct var_num n;
+
+	memset(&n, 0, sizeof(n));
+	n.num = (double)num;
+	n.i = num;
+
+	return _v_at_set(list, -1, &n, sizeof(n), VAR_TYPE_INT);
+}
+
+
+/******************************************************************************/
+int varl_set_at_str(var_list_t list, int index, const char *string, ...)
+{
+	int size, err;
+	va_list args;
+	char *newstr = NULL;
+
+	if (index < 0) return -1;
+	va_start(args, string);
+	size = vasprintf(&newstr, string, args);
+	va_end(args);
+	if (size < 0) return -1;
+
+	err = _v_at_set(list, index, newstr, size + 1, VAR_TYPE_STR);
+	free(newstr);
+
+	return err < 0 ? -1 : 0;
+}
+
+
+/******************************************************************************/
+int varl_set_at_num(var_list_t list, int index, double num)
+{
+	struct var_num n;
+
+	if (index < 0) return -1;
+	memset(&n, 0, sizeof(n));
+	n.num = num;
+	n.i = (int)num;
+
+	return _v_at_set(list, index, &n, sizeof(n), VAR_TYPE_NUM) < 0 ? -1 : 0;
+}
+
+
+/******************************************************************************/
+int varl_set_at_int(var_list_t list, int index, int num)
+{
+	struct var_num n;
+
+	if (index < 0) return -1;
+	memset(&n, 0, sizeof(n));
+	n.num = (double)num;
+	n.i = num;
+
+	return _v_at_set(list, index, &n, sizeof(n), VAR_TYPE_INT) < 0 ? -1 : 0;
+}
+
+
+/******************************************************************************/
+int varl_set_bin(var_list_t list, const char *name, void *data, size_t size)
+{
+	int err;
+	err = _v_list_set(list, name, data, size, VAR_TYPE_BIN);
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Remove all items from overlay, keeping its hash
+ * index and first arena block for reuse.
+ * Only owning thread sees overlay, so memory is freed right away.
+ * @note Caller must be thread owning overlay.
+ */
+static void _v_overlay_reset(struct var_list *l)
+{
+	struct var_item *v;
+
+	for (v = l->first; v; v = v->next)
+	{
+		_v_retire_data(l, v, v->type, v->data);
+		_v_retire(l, v, _v_item_arena_free);
+	}
+	_v_retire_flush_to(&l->retired, &l->retired_c, &l->retired_size);
+
+	if (l->hash) memset(l->hash, 0, sizeof(*l->hash) * l->hash_size);
+	_v_trie_free(l->trie);
+	l->trie = NULL;
+	if (l->arena)
+	{
+		_v_arena_free(l->arena->next);
+		l->arena->next = NULL;
+		l->arena->used = 0;
+	}
+
+	l->first = NULL;
+	l->last = NULL;
+	l->current = NULL;
+	l->current_layer = NULL;
+	l->count = 0;
+	l->own_count = 0;
+}
+
+
+/******************************************************************************/
+int var_overlay_begin(const var_list_t *lists, int count)
+{
+	struct var_reader *r;
+	var_list_t *shadow;
+
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+	if (!lists || count < 1) return -1;
+	r = _v_reader();
+	if (!r) return -1;
+
+	if (!r->overlay)
+	{
+		r->overlay = (struct var_list *)malloc(sizeof(*r->overlay));
+		if (!r->overlay) return -1;
+		memset(r->overlay, 0, sizeof(*r->overlay));
+		r->overlay->flags = VAR_LIST_ARENA | VAR_LIST_LOCAL;
+		r->overlay->name_next = -1;
+		r->overlay->id = -1;
+	}
+	/* Record might have been left with items by exited thread. */
+	else if (r->overlay->first) _v_overlay_reset(r->overlay);
+
+	if (count > r->shadow_size)
+	{
+		shadow = (var_list_t *)realloc(r->shadow, sizeof(*shadow) * count);
+		if (!shadow) return -1;
+		r->shadow = shadow;
+		r->shadow_size = count;
+	}
+	memcpy(r->shadow, lists, sizeof(*lists) * count);
+	r->shadow_c = count;
+
+	return 0;
+}
+
+
+/******************************************************************************/
+void var_overlay_end(void)
+{
+	struct var_reader *r = var_reader;
+
+	if (!r || !r->overlay) return;
+	_v_overlay_reset(r->overlay);
+	r->shadow_c = 0;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Set variable in overlay of calling thread.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+static int _v_overlay_set(const char *name, void *data, int size, int type)
+{
+	if (!name || !_v_overlay_on()) return -1;
+	return _v_put(var_reader->overlay, name, _v_hash(name), 1, data, size, type);
+}
+
+
+/******************************************************************************/
+int var_overlay_set_str(const char *name, const char *string, ...)
+{
+	int size, err;
+	va_list args;
+	char *newstr = NULL;
+
+	va_start(args, string);
+	size = vasprintf(&newstr, string, args);
+	va_end(args);
+	if (size < 0) return -1;
+	size++; /* Include terminating null char in size. */
+
+	err = _v_overlay_set(name, newstr, size, VAR_TYPE_STR);
+
+	free(newstr);
+
+	return err;
+}
+
+
+/******************************************************************************/
+int var_overlay_set_num(const char *name, double num)
+{
+	struct var_num n;
+
+	memset(&n, 0, sizeof(n));
+	n.num = num;
+	n.i = (int)num;
+
+	return _v_overlay_set(name, &n, sizeof(n), VAR_TYPE_NUM);
+}
+
+
+/******************************************************************************/
+int var_overlay_set_int(const char *name, int num)
+{
+	struct var_num n;
+
+	memset(&n, 0, sizeof(n));
+	n.num = (double)num;
+	n.i = num;
+
+	return _v_overlay_set(name, &n, sizeof(n), VAR_TYPE_INT);
+}
+
+
+/******************************************************************************/
+int varl_set_many(var_list_t list, const char **names, const char **values, size_t count)
+{
+	struct var_list *l;
+	const char *value;
+	int err = 0;
+	size_t j;
+
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+	if (!names || !values) return -1;
+
+	/* Existing items in all lists are found from global index one by one. */
+	if (list < 0)
+	{
+		for (j = 0; j < count; j++)
+		{
+			if (!names[j]) continue;
+			value = values[j] ? values[j] : var_empty_string;
+			if (_v_list_set(list, names[j], (void *)value, strlen(value) + 1, VAR_TYPE_STR)) err = -1;
+		}
+		return err;
+	}
+	if (list >= _v_lists()) return -1;
+
+	l = _v_list(list);
+	if (_v_lock_list(l)) return -1;
+
+	/* Make room in hash index for all new items at once. */
+	if (l->own_count + count > l->hash_size) _v_hash_grow(l, l->own_count + count);
+
+	for (j = 0; j < count; j++)
+	{
+		if (!names[j]) continue;
+		value = values[j] ? values[j] : var_empty_string;
+		if (_v_put(l, names[j], _v_hash(names[j]), 1, (void *)value, strlen(value) + 1, VAR_TYPE_STR)) err = -1;
+	}
+
+	lock_unlock(&l->lock);
+
+	return err;
+}
+
+
+/******************************************************************************/
+void varl_rm(var_list_t list, const char *name)
+{
+	struct var_list *l;
+	unsigned int hash;
+	var_list_t *ids;
+	int i, n, c, found = 0;
+
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return;
+	/* Return, if name is invalid. */
+	if (!name) return;
+
+	/* Check search conditions, -1 removes first occurrence from any list. */
+	n = _v_lists();
+	if (list < 0 && (c = _v_keys_copy(name, _v_hash(name), &ids)) > -1)
+	{
+		for (hash = _v_hash(name), i = 0; i < c && !found; i++)
+		{
+			if (ids[i] >= n) continue;
+			l = _v_list(ids[i]);
+			if (_v_lock_list(l)) continue;
+			found = _v_rm_name(l, name, hash);
+			lock_unlock(&l->lock);
+		}
+		if (ids) free(ids);
+		return;
+	}
+	if (list < 0) i = 0;
+	else
+	{
+		i = list;
+		n = list < n ? list + 1 : 0;
+	}
+
+	for (hash = _v_hash(name); i < n && !found; i++)
+	{
+		l = _v_list(i);
+		if (_v_lock_list(l)) continue;
+		found = _v_rm_name(l, name, hash);
+		lock_unlock(&l->lock);
+	}
+}
+
+
+/******************************************************************************/
+var_list_t varl_cp(var_list_t list, char *name)
+{
+	struct var_list *l, *c;
+	var_list_t copy;
+
+	/* Return error, if lib not initialized yet or list is invalid. */
+	if (list < 0 || list >= _v_lists()) return -1;
+	l = _v_list(list);
+	if (_v_iterating(l)) return -1;
+	/* Copy must be a new list. */
+	copy = _v_list_new(name, l->flags, 1);
+	if (copy < 0) return -1;
+	c = _v_list(copy);
+
+	_v_lock_write(&l->lock, &l->stats.lock_wait_ns);
+	/* Keep finding items from base fast, base is flattened when too deep. */
+	if (l->base && l->base->depth >= VAR_LAYER_DEPTH_MAX) _v_flatten(l);
+	if (_v_freeze(l))
+	{
+		lock_unlock(&l->lock);
+		return -1;
+	}
+
+	_v_lock_write(&c->lock, &c->stats.lock_wait_ns);
+	if (l->base) __atomic_add_fetch(&l->base->refs, 1, __ATOMIC_ACQ_REL);
+	__atomic_store_n(&c->base, l->base, __ATOMIC_RELEASE);
+	c->count = l->count;
+	_v_keys_list(c, 1);
+	__atomic_add_fetch(&var_items_version, 1, __ATOMIC_RELEASE);
+	_v_slot_list(c);
+	lock_unlock(&c->lock);
+
+	lock_unlock(&l->lock);
+	return copy;
+}
+
+
+/******************************************************************************/
+void varl_clear(var_list_t list)
+{
+	/* Return, if lib not initialized yet. */
+	if (list < 0 || list >= _v_lists()) return;
+
+	if (_v_lock_list(_v_list(list))) return;
+	_v_keys_list(_v_list(list), 0);
+	_v_clear(_v_list(list));
+	lock_unlock(&_v_list(list)->lock);
+}
+
+
+/******************************************************************************/
+/**
+ * Get data as ascii string (if possible). List ID can be -1, in which case
+ * all list are searched and first occurrense of name item is returned.
+ *
+ * @param list ID of list to be used returned by varl_new().
+ * @param name Name of data string to get.
+ * @return Pointer to ascii string, or pointer to "" (empty string), if
+ *         no such item found or if item cannot be converted as string.
+ */
+const char *varl_get_str(var_list_t list, char *name)
+{
+	struct var_item *v;
+	char *p = var_empty_string;
+	void *data;
+	int type;
+	
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return var_empty_string;
+	/* Return, if name is invalid. */
+	if (!name) return var_empty_string;
+	if (var_read_begin()) return var_empty_string;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		type = _v_get(v, &data, NULL);
+		p = _v_str(type, data);
+		if (!p) p = var_empty_string;
+	}
+	
+	/* expand variables */
+	if (vopt[VAR_OPT_EXPAND]) p = (char *)_v_expand(list, p);
+	
+	var_read_end();
+	return p;
+}
+
+
+/******************************************************************************/
+/**
+ * Get data as double, if invalid zero is returned. List ID can be -1, in
+ * which case all list are searched and first occurrense of name item is
+ * returned.
+ *
+ * @param list ID of list to be used returned by varl_new().
+ * @param name Name of data string to get.
+ * @return Value of string as double, or zero on errors.
+ */
+double varl_get_num(var_list_t list, char *name)
+{
+	struct var_item *v;
+	double num;
+	void *data;
+
+	if (var_read_begin()) return 0.0;
+	v = _v_find(list, name);
+	if (v && VAR_TYPE_IS_NUM(_v_get(v, &data, NULL))) num = ((struct var_num *)data)->num;
+	else num = atof(varl_get_str(list, name));
+	var_read_end();
+
+	return num;
+}
+
+
+/******************************************************************************/
+/**
+ * Get data as integer, if invalid zero is returned. List ID can be -1, in
+ * which case all list are searched and first occurrense of name item is
+ * returned.
+ *
+ * @param list ID of list to be used returned by varl_new().
+ * @param name Name of data string to get.
+ * @return Value of string as integer, or zero on errors.
+ */
+int varl_get_int(var_list_t list, char *name)
+{
+	struct var_item *v;
+	void *data;
+	int num;
+
+	if (var_read_begin()) return 0;
+	v = _v_find(list, name);
+	if (v && VAR_TYPE_IS_NUM(_v_get(v, &data, NULL))) num = ((struct var_num *)data)->i;
+	else num = atoi(varl_get_str(list, name));
+	var_read_end();
+
+	return num;
+}
+
+
+/******************************************************************************/
+/**
+ * Internal help routine: Find variable by index from list given by ID.
+ * Overlay of thread can shadow item, so then it is found by name.
+ * @note Caller must be inside var_read_begin().
+ *
+ * @return Pointer to variable struct, or NULL.
+ */
+static struct var_item *_v_find_at(var_list_t list, int index)
+{
+	char key[12];
+
+	if (list < 0 || list >= _v_lists() || index < 0) return NULL;
+	if (!_v_overlay_on()) return _v_at(_v_list(list), index);
+	_v_index_key(key, index);
+	return _v_find(list, key);
+}
+
+
+/******************************************************************************/
+const char *varl_get_at_str(var_list_t list, int index)
+{
+	struct var_item *v;
+	char *p = var_empty_string;
+	void *data;
+	int type;
+
+	if (var_read_begin()) return var_empty_string;
+	v = _v_find_at(list, index);
+	if (v)
+	{
+		type = _v_get(v, &data, NULL);
+		p = _v_str(type, data);
+		if (!p) p = var_empty_string;
+	}
+	if (vopt[VAR_OPT_EXPAND]) p = (char *)_v_expand(list, p);
+	var_read_end();
+
+	return p;
+}
+
+
+/******************************************************************************/
+double varl_get_at_num(var_list_t list, int index)
+{
+	struct var_item *v;
+	double num;
+	void *data;
+
+	if (var_read_begin()) return 0.0;
+	v = _v_find_at(list, index);
+	if (v && VAR_TYPE_IS_NUM(_v_get(v, &data, NULL))) num = ((struct var_num *)data)->num;
+	else num = atof(varl_get_at_str(list, index));
+	var_read_end();
+
+	return num;
+}
+
+
+/******************************************************************************/
+int varl_get_at_int(var_list_t list, int index)
+{
+	struct var_item *v;
+	void *data;
+	int num;
+
+	if (var_read_begin()) return 0;
+	v = _v_find_at(list, index);
+	if (v && VAR_TYPE_IS_NUM(_v_get(v, &data, NULL))) num = ((struct var_num *)data)->i;
+	else num = atoi(varl_get_at_str(list, index));
+	var_read_end();
+
+	return num;
+}
+
+
+/******************************************************************************/
+/**
+ * Get data as binary. Strings and numbers are returned as binary too,
+ * without the terminating null character.
+ *
+ * @param list ID of list to be used returned by varl_new().
+ * @param name Name of data to get.
+ * @param size Pointer where to store size of data, can be NULL.
+ * @return Pointer to data, or NULL if no such item found.
+ */
+const void *varl_get_bin(var_list_t list, char *name, int *size)
+{
+	struct var_item *v;
+	void *data = NULL;
+	size_t n = 0;
+	int type;
+
+	if (size) *size = 0;
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return NULL;
+	/* Return, if name is invalid. */
+	if (!name) return NULL;
+	if (var_read_begin()) return NULL;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		type = _v_get(v, &data, &n);
+		switch (type)
+		{
+		case VAR_TYPE_NUM:
+		case VAR_TYPE_INT:
+			data = _v_str(type, data);
+			n = data ? strlen(data) : 0;
+			break;
+		case VAR_TYPE_STR:
+			n = strlen(data);
+			break;
+		case VAR_TYPE_BIN:
+			break;
+		default:
+			data = NULL;
+			n = 0;
+			break;
+		}
+	}
+	if (size) *size = (int)n;
+
+	var_read_end();
+	return data;
+}
+
+
+/******************************************************************************/
+int varl_get_many(var_list_t list, const char **names, const char **values, size_t count)
+{
+	struct var_item *v;
+	int type, found = 0;
+	void *data;
+	char *str;
+	size_t j;
+
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return -1;
+	if (!names || !values) return -1;
+	if (var_read_begin()) return -1;
+
+	for (j = 0; j < count; j++)
+	{
+		values[j] = var_empty_string;
+		v = _v_find(list, (char *)names[j]);
+		if (!v) continue;
+		type = _v_get(v, &data, NULL);
+		str = _v_str(type, data);
+		if (!str) continue;
+		values[j] = str;
+		found++;
+	}
+
+	var_read_end();
+	return found;
+}
+
+
+/******************************************************************************/
+/**
+ * Compare variable value to given.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of data string to get.
+ * @param value Value to be compared against.
+ * @return 1 if value is same, zero if it's not.
+ */
+int varl_is_str(var_list_t list, char *name, char *value)
+{
+	struct var_item *v;
+	void *data;
+	int type, err = 0;
+
+	if (var_read_begin()) return err;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		type = _v_get(v, &data, NULL);
+		data = _v_str(type, data);
+		if (data && strcmp(data, value) == 0) err = 1;
+	}
+	var_read_end();
+	
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Compare variable value to given integer value.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of data string to get.
+ * @param value Value to be compared against.
+ * @return 1 if value is same, zero if it's not.
+ */
+int varl_is_num(var_list_t list, char *name, double value)
+{
+	struct var_item *v;
+	void *data;
+	int err = 0;
+	
+	if (var_read_begin()) return err;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		switch (_v_get(v, &data, NULL))
+		{
+		case VAR_TYPE_STR:
+			if (atof(data) == value) err = 1;
+			break;
+		case VAR_TYPE_NUM:
+		case VAR_TYPE_INT:
+			if (((struct var_num *)data)->num == value) err = 1;
+			break;
+		}
+	}
+	var_read_end();
+	
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Compare variable value to given integer value.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of data string to get.
+ * @param value Value to be compared against.
+ * @return 1 if value is same, zero if it's not.
+ */
+int varl_is_int(var_list_t list, char *name, int value)
+{
+	struct var_item *v;
+	void *data;
+	int err = 0;
+	
+	if (var_read_begin()) return err;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		switch (_v_get(v, &data, NULL))
+		{
+		case VAR_TYPE_STR:
+			if (atoi(data) == value) err = 1;
+			break;
+		case VAR_TYPE_NUM:
+		case VAR_TYPE_INT:
+			if (((struct var_num *)data)->i == value) err = 1;
+			break;
+		}
+	}
+	var_read_end();
+	
+	return err;
+}
+
+
+/******************************************************************************/
+/**
+ * Check whether variable has some content or is empty.
+ * Variable is defined as empty also, if it is not found at all.
+ * In case of different types, empty means following:
+ * <br>ascii: if string length is 0, then return empty.
+ * <br>numeric: returns always not empty.
+ * <br>binary: if data length is less than 1.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of data string to get.
+ * @return 0 if variable is non-empty string, 1 if it is empty.
+ */
+int varl_is_empty(var_list_t list, char *name)
+{
+	struct var_item *v;
+	void *data;
+	int err = 1;
+
+	if (list < 0 || list >= _v_lists()) return 1;
+	
+	if (var_read_begin()) return err;
+
+	v = _v_find(list, name);
+	if (v)
 	{
-		if (strcmp(var_list[i].name, name) == 0) goto out_err;
+		switch (_v_get(v, &data, NULL))
+		{
+		case VAR_TYPE_STR:
+			if (strlen(data) > 0) err = 0;
+			break;
+		case VAR_TYPE_NUM:
+		case VAR_TYPE_INT:
+			err = 0;
+			break;
+		}
 	}
-	i = -1;
+	var_read_end();
+	
+	return err;
+}
 
-out_err:
-	lock_unlock(&var_list_lock);
-	return i;
+
+/******************************************************************************/
+/**
+ * Return 1 if the contents can be defined as "true". 0 (false) otherwise.
+ * If the item is binary, false is returned always. Also if the item
+ * does not exists, false is returned.
+ *
+ * <br>Contents can be defined as true in following cases:
+ * <br>The item is numerical and has value other than zero.
+ * <br>The item is string and the content is not empty string nor "0"
+ *
+ * @param list List ID which to used in search.
+ * @param name Variable identifier key.
+ * @return Length of the variables string presentation.
+ */
+int varl_is(var_list_t list, char *name)
+{
+	struct var_item *v;
+	void *data;
+	int err = 0;
+	
+	if (var_read_begin()) return err;
+
+	v = _v_find(list, name);
+	if (v)
+	{
+		switch (_v_get(v, &data, NULL))
+		{
+		case VAR_TYPE_STR:
+			if (strlen(data) < 1) err = 0;
+			else if (strcmp(data, "0") == 0) err = 0;
+			else err = 1;
+			break;
+		case VAR_TYPE_NUM:
+		case VAR_TYPE_INT:
+			err = (((struct var_num *)data)->num == 0.0f) ? 0 : 1;
+			break;
+		default:
+			err = 0;
+			break;
+		}
+	}
+	var_read_end();
+	
+	return err;
 }
 
 
 /******************************************************************************/
-int varl_rename(var_list_t list, char *name)
+/**
+ * Set variable as true. Same as setting value to (int)1.
+ *
+ * @param list List ID which to used in search.
+ * @param key Variable identifier key.
+ */
+void varl_true(var_list_t list, char *key)
 {
-	if (!var_list) return -1;
-	if (list >= var_list_c || list < 0) return -1;
-	lock_write(&var_list_lock);
-	STRCPY(var_list[list].name, name);
-	lock_unlock(&var_list_lock);
-	return 0;
+	varl_set_num(list, key, (double)1);
 }
 
 
 /******************************************************************************/
 /**
- * Set variable as ascii string.
- * This function searches, if item within this name is already found,
- * and replaces it, or creates new one if old not found.
- * List ID should be some of following:
- * 0 which is default list, list ID returned by varl_new() (>0),
- * or -1 which means all lists. If -1 is defined, then all lists are searched
- * for occurenses of name and data for all found items is set to given.
- * In this case (-1), no new items are created in lists.
+ * Set variable as false. Same as setting value to (int)0.
  *
- * @param list ID of list to be used returned by varl_new().
- *             0 can be used as default list, and it is always 
- *             available after var_init() has been called.
- *             See more from description.
- * @param name Name of item to be set.
- * @param string printf() style formatted string and arguments following.
- * @return Returns 0 on success, -1 on errors.
+ * @param list List ID which to used in search.
+ * @param key Variable identifier key.
  */
-int varl_set_str(var_list_t list, char *name, char *string, ...)
+void varl_false(var_list_t list, char *key)
+{
+	varl_set_num(list, key, (double)0);
+}
+
+
+/******************************************************************************/
+/**
+ * Return length of the variable, if it is a string. Error (-1) otherwise.
+ *
+ * @param list List ID which to used in search.
+ * @param name Name of data string to get.
+ * @return Length of the variables string presentation.
+ */
+int varl_strlen(var_list_t list, char *name)
 {
-	int size, create, err;
 	struct var_item *v;
-	va_list args;
-	char *newstr = NULL;
+	void *data;
+	int type, err = 0;
+	
+	if (var_read_begin()) return err;
 
-	/* Format given ascii data. */
-	va_start(args, string);
-	size = vasprintf(&newstr, string, args);
-	va_end(args);
-	if (size < 0) return -1;
-	size++; /* Include terminating null char in size. */
+	v = _v_find(list, name);
+	if (v)
+	{
+		type = _v_get(v, &data, NULL);
+		data = _v_str(type, data);
+		if (data) err = strlen(data);
+		else err = -1;
+	}
+	var_read_end();
 	
-	/* Go trough requested lists. */
-	err = _v_list_set(list, name, newstr, size, VAR_TYPE_STR);
+	return err;
+}
 
-	free(newstr);
 
-	return err;
+/******************************************************************************/
+/**
+ * Parse variable into buffer.
+ *
+ * @param list List ID which to search for the variable.
+ * @param name Name of variable.
+ * @param lists List IDs, which are used when searhing variables in string.
+ * @param lc Number of items in lists.
+ * @return Allocated pointer to parsed string.
+ *         Must be freed after usage.
+ *         Returns empty string on errors also.
+ */
+const char *varl_parsev(var_list_t list, char *name, int *lists, int lc)
+{
+	struct var_parse p;
+	struct var_item *v;
+	struct var_list l;
+	unsigned int kv;
+	void *data;
+	int type;
+
+	/* Return, if lib not initialized yet. */
+	if (_v_lists() < 1) return var_empty_string;
+	/* Return, if name is invalid. */
+	if (!name) return var_empty_string;
+	if (var_read_begin()) return var_empty_string;
+
+	memset(&p, 0, sizeof(p));
+	p.version = __atomic_load_n(&var_items_version, __ATOMIC_ACQUIRE);
+	p.cache = lc == 1 && !_v_overlay_on();
+	kv = _v_key_version(_v_hash(name));
+	v = _v_find(list, name);
+	if (!v) goto out_err;
+	type = _v_get(v, &data, NULL);
+	if (type != VAR_TYPE_STR && !VAR_TYPE_IS_NUM(type)) goto out_err;
+	
+	/* Parse variable content. */
+	memset(&l, 0, sizeof(l));
+	_v_parse(v, &p, &l, lists, lc, kv);
+
+out_err:
+	var_read_end();
+	if (p.dep) free(p.dep);
+	if (!p.b.p) return var_empty_string;
+	return p.b.p;
+}
+
+
+/******************************************************************************/
+/**
+ * Parse variable into buffer.
+ *
+ * @param list List ID which to search for the variable.
+ * @param name Name of variable.
+ * @param argv List IDs, which are used when searhing variables in string.
+               End list with -1, or if this is the only ID given,
+               then all lists are used.
+ * @return Return result, or 0 on errors.
+ */
+const char *varl_parse(var_list_t list, char *name, void *argv, ...)
+{
+	int lc, *lists, all, i;
+	const char *result = NULL;
+	
+	/* Calculate lists count. */
+	for (lc = 0; (long)((&argv)[lc]) != -1; lc++);
+
+	/* If no lists, then use all. */
+	if (lc < 1)
+	{
+		all = -1;
+		lists = &all;
+		lc = 1;
+	}
+	/* Retrieve lists, if given. */
+	else 
+	{
+		all = 0;
+		lists = (int *)malloc(sizeof(*lists) * lc);
+		if (!lists) goto out_err;
+		for (i = 0; i < lc; i++) lists[i] = (int)((&argv)[i]);
+	}
+
+	/* Parse variable content. */
+	result = varl_parsev(list, name, lists, lc);
+	
+out_err:
+	if (lists && !all) free(lists);
+	if (!result) result = var_empty_string;
+	return result;
+}
+
+
+/******************************************************************************/
+/**
+ * First parse, then calculate variable and return result.
+ *
+ * @param list List ID which to search for the variable.
+ * @param name Name of variable.
+ * @param argv List IDs, which are used when searhing variables in string.
+ *             End list with -1, or if this is the only ID given,
+ *             then all lists are used.
+ * @return Return result, or 0 on errors.
+ */
+double varl_calc(var_list_t list, char *name, void *argv, ...)
+{
+	int lc, *lists, all, i;
+	const char *res = NULL;
+	double result = 0.0F;
+	
+	/* Calculate lists count. */
+	for (lc = 0; (long)((&argv)[lc]) != -1; lc++);
+
+	/* If no lists, then use all. */
+	if (lc < 1)
+	{
+		all = -1;
+		lists = &all;
+		lc = 1;
+	}
+	/* Retrieve lists, if given. */
+	else 
+	{
+		all = 0;
+		lists = (int *)malloc(sizeof(int) * lc);
+		if (!lists) goto out_err;
+		for (i = 0; i < lc; i++) lists[i] = (int)((&argv)[i]);
+	}
+
+	/* Parse variable content. */
+	res = varl_parsev(list, name, lists, lc);
+
+	/* Calculate it's value. */
+	result = strmath_calc(res, NULL);
+
+out_err:
+	if (res) free(res);
+	if (lists && !all) free(lists);
+	return result;
+}
+
+
+/******************************************************************************/
+/**
+ * Free given data.
+ *
+ * @param ptr Pointer to data to be freed.
+ */
+void varl_free(void *ptr)
+{
+	/* If NULL pointer somewhy given. */
+	if (!ptr) return;
+	/* If pointer is internal empty string pointer. */
+	if (ptr == var_empty_string) return;
+	free(ptr);
 }
 
 
 /******************************************************************************/
 /**
- * As varl_set_str, but set variable as number.
+ * Internal help routine: Tokenize file in format described in
+ * varl_file_prefunc(). File is mapped to memory and lines are tokenized
+ * in place, names and values are given to callbacks as pointer and length
+ * into the mapping and are not null terminated.
  *
- * @param list ID of list to be used.
- * @param name Name of item to be set.
- * @param num Number to be set.
- * @return Returns 0 on success, -1 on errors.
+ * @param file Filename.
+ * @param ctx Context given to callbacks.
+ * @param list_f Called with name of each new list.
+ * @param var_f Called with name and value of each variable.
+ * @return 0 on success, -1 on errors or if callback returns error.
  */
-int varl_set_num(var_list_t list, char *name, double num)
+static int _v_file_scan(const char *file, void *ctx,
+	int (*list_f)(void *, const char *, size_t),
+	int (*var_f)(void *, const char *, size_t, const char *, size_t))
 {
-	int size, err;
-	char *str;
+	const char *map, *end, *p, *eol, *s, *e, *m, *q;
+	struct stat st;
+	int fd, err = 0;
 
-	/* Format given number as ascii data. */
-	size = asprintf(&str, "%lf", num);
-	if (size < 0) return -1;
-	size++; /* Include terminating null char in size. */
-	
-	/* Go trough requested lists. */
-	err = _v_list_set(list, name, str, size, VAR_TYPE_NUM);
+	/* Open and map file. */
+	if (!file) return -1;
+	fd = open(file, O_RDONLY);
+	if (fd < 0) return -1;
+	if (fstat(fd, &st))
+	{
+		close(fd);
+		return -1;
+	}
+	if (st.st_size < 1)
+	{
+		close(fd);
+		return 0;
+	}
+	map = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) return -1;
+	madvise((void *)map, st.st_size, MADV_SEQUENTIAL);
+
+	for (p = map, end = map + st.st_size; p < end && !err; p = eol + 1)
+	{
+		eol = (const char *)memchr(p, '\n', end - p);
+		if (!eol) eol = end;
 
-	free(str);
+		/* Trim line. */
+		for (s = p; s < eol && isspace((unsigned char)*s); s++);
+		for (e = eol; e > s && isspace((unsigned char)e[-1]); e--);
+		if (s == e) continue;
 
-	return err;
+		/* Dont parse commented lines. */
+		if (*s == '#') continue;
+
+		/* Parse new list. */
+		if (*s == '[')
+		{
+			q = (const char *)memchr(s + 1, ']', e - s - 1);
+			if (!q) q = e;
+			if (q > s + 1) err = list_f(ctx, s + 1, q - s - 1);
+			continue;
+		}
+
+		/* Parse variable, name is followed by spaces and equals sign. */
+		for (m = s; m < e && *m != ' ' && *m != '=' && *m != '\t'; m++);
+		for (q = m; q < e && (*q == ' ' || *q == '=' || *q == '\t'); q++);
+		if (m == s || q == e || !memchr(m, '=', q - m)) continue;
+		if (*q == '\"' || *q == '\'')
+		{
+			p = (const char *)memchr(q + 1, *q, e - q - 1);
+			if (p)
+			{
+				e = p;
+				q++;
+			}
+		}
+		err = var_f(ctx, s, m - s, q, e - q);
+	}
+
+	munmap((void *)map, st.st_size);
+	return err ? -1 : 0;
 }
 
 
 /******************************************************************************/
 /**
- * As varl_set_num, but set variable as integer number, not double.
- *
- * @param list ID of list to be used.
- * @param name Name of item to be set.
- * @param num Number to be set.
- * @return Returns 0 on success, -1 on errors.
+ * Internal help routine: Start new list while loading file.
  */
-int varl_set_int(var_list_t list, char *name, int num)
+static int _v_file_list(void *ctx, const char *name, size_t len)
 {
-	return varl_set_num(list, name, (double)num);
-}
+	struct var_file *f = (struct var_file *)ctx;
 
+	f->name.len = 0;
+	if (_v_buf_add(&f->name, name, len)) return -1;
+	f->list = varl_new(f->name.p);
 
-/******************************************************************************/
-int varl_set_bin(var_list_t list, const char *name, void *data, size_t size)
-{
-	int err;
-	err = _v_list_set(list, name, data, size, VAR_TYPE_BIN);
-	return err;
+	return 0;
 }
 
 
 /******************************************************************************/
-void varl_rm(var_list_t list, const char *name)
+/**
+ * Internal help routine: Set variable while loading file.
+ * Value is copied only once, when it is set to list.
+ */
+static int _v_file_var(void *ctx, const char *name, size_t nlen, const char *value, size_t vlen)
 {
-	struct var_item *v;
-	
-	lock_write(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+	struct var_file *f = (struct var_file *)ctx;
+	int done = 0;
+
+	if (f->prefunc_n) done = f->prefunc_n(f->list, name, nlen, value, vlen);
+	else if (f->prefunc)
 	{
-		_v_free(v);
+		f->value.len = 0;
+		if (_v_buf_add(&f->value, value, vlen) || _v_buf_add(&f->value, "", 1)) return -1;
+		f->name.len = 0;
+		if (_v_buf_add(&f->name, name, nlen)) return -1;
+		done = f->prefunc(f->list, f->name.p, f->value.p);
 	}
-	lock_unlock(&var_list_lock);
+	if (done) return 0;
+
+	f->name.len = 0;
+	if (_v_buf_add(&f->name, name, nlen)) return -1;
+	_v_list_set(f->list, f->name.p, (void *)value, vlen, VAR_TYPE_STR);
+
+	return 0;
 }
 
 
 /******************************************************************************/
 /**
- * Get data as ascii string (if possible). List ID can be -1, in which case
- * all list are searched and first occurrense of name item is returned.
+ * Internal help routine: Load file into string variables.
+ * @note Only one of prefunc and prefunc_n is used.
  *
- * @param list ID of list to be used returned by varl_new().
- * @param name Name of data string to get.
- * @return Pointer to ascii string, or pointer to "" (empty string), if
- *         no such item found or if item cannot be converted as string.
+ * @return 0 on success, -1 on errors.
  */
-const char *varl_get_str(var_list_t list, char *name)
+static int _v_file(const char *file, int (*prefunc)(var_list_t, const char *, const char *),
+	int (*prefunc_n)(var_list_t, const char *, size_t, const char *, size_t))
 {
-	int i, n;
-	struct var_item *v;
-	char *p = var_empty_string;
-	
-	/* Return, if lib not initialized yet. */
-	if (!var_list) return var_empty_string;
-	/* Return, if name is invalid. */
-	if (!name) return var_empty_string;
+	struct var_file f;
+	int err;
 
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
-	{
-		if (v->type == VAR_TYPE_STR)
-		{
-			p = v->data;
-		}
-		else if (v->type == VAR_TYPE_NUM) p = v->data;
-		else p = var_empty_string;
-	}
-	
-	/* expand variables */
-	while (vopt[VAR_OPT_EXPAND])
-	{
-		char *e, *ep, *epsave, *format, **arglist;
-		struct var_item *v;
-		int c;
-		
-		epsave = ep = strdup(p);
-		if (!ep) break;
-		format = malloc(strlen(p));
-		if (!format)
-		{
-			free(ep);
-			break;
-		}
-		*format = '\0';
-		
-		/* find expandable variables */
-		arglist = NULL;
-		c = 0;
-		while ((e = strpbrk(ep, VAR_CHARS)))
-		{
-			v = _v_find_best(list, e + 1);
-			if (v)
-			{
-				*e = '\0';
-				strcat(format, ep);
-				strcat(format, "%s");
-				printf("1: %s, %d, %s\n", v->key, atoi(v->data), format);
-				c++;
-				arglist = realloc(arglist, c * sizeof(*arglist));
-				if (!arglist) break;
-				arglist[c - 1] = v->data;
-				ep = e + strlen(v->key) + 1;
-				printf("%s, %s\n", ep, v->data);
-			}
-			else
-			{
-				ep = e + 1;
-			}
-		}
-		strcat(format, ep);
-		
-		/* expand */
-		if (arglist)
-		{
-			asprintf(&p, format, *arglist);
-			printf("%s, %s, %s\n", p, format, arglist[0]);
-			free(arglist);
-		}
-		
-		free(format);
-		free(epsave);
-		break;
-	}
+	memset(&f, 0, sizeof(f));
+	f.prefunc = prefunc;
+	f.prefunc_n = prefunc_n;
+	err = _v_file_scan(file, &f, _v_file_list, _v_file_var);
+	if (f.name.p) free(f.name.p);
+	if (f.value.p) free(f.value.p);
 
-	lock_unlock(&var_list_lock);
-	
-	return p;
+	return err;
 }
 
 
 /******************************************************************************/
 /**
- * Get data as double, if invalid zero is returned. List ID can be -1, in
- * which case all list are searched and first occurrense of name item is
- * returned.
+ * Internal help routine: Add line to parsed file.
  *
- * @param list ID of list to be used returned by varl_new().
- * @param name Name of data string to get.
- * @return Value of string as double, or zero on errors.
+ * @param value Value of variable, or NULL for new list.
+ * @return 0 on success, -1 on errors.
  */
-double varl_get_num(var_list_t list, char *name)
+static int _v_stage_add(struct var_stage *st, const char *name, size_t nlen, const char *value, size_t vlen)
 {
-	const char *str = varl_get_str(list, name);
-	return atof(str);
+	struct var_stage_line *line;
+	size_t size;
+
+	if (st->line_c >= st->line_size)
+	{
+		size = st->line_size ? st->line_size * 2 : VAR_MIN_MALLOC;
+		line = (struct var_stage_line *)realloc(st->line, sizeof(*line) * size);
+		if (!line) return -1;
+		st->line = line;
+		st->line_size = size;
+	}
+
+	line = &st->line[st->line_c];
+	line->name = st->b.len;
+	if (_v_buf_add(&st->b, name, nlen) || _v_buf_add(&st->b, "", 1)) return -1;
+	line->value = st->b.len;
+	if (!value) line->value = (size_t)-1;
+	else if (_v_buf_add(&st->b, value, vlen) || _v_buf_add(&st->b, "", 1)) return -1;
+	st->line_c++;
+
+	return 0;
 }
 
 
 /******************************************************************************/
 /**
- * Get data as integer, if invalid zero is returned. List ID can be -1, in
- * which case all list are searched and first occurrense of name item is
- * returned.
- *
- * @param list ID of list to be used returned by varl_new().
- * @param name Name of data string to get.
- * @return Value of string as integer, or zero on errors.
+ * Internal help routine: Add new list to parsed file.
  */
-int varl_get_int(var_list_t list, char *name)
+static int _v_stage_list(void *ctx, const char *name, size_t len)
 {
-	const char *str = varl_get_str(list, name);
-	return atoi(str);
+	return _v_stage_add((struct var_stage *)ctx, name, len, NULL, 0);
 }
 
 
 /******************************************************************************/
 /**
- * Compare variable value to given.
- *
- * @param list List ID which to used in search.
- * @param name Name of data string to get.
- * @param value Value to be compared against.
- * @return 1 if value is same, zero if it's not.
+ * Internal help routine: Add variable to parsed file.
  */
-int varl_is_str(var_list_t list, char *name, char *value)
+static int _v_stage_var(void *ctx, const char *name, size_t nlen, const char *value, size_t vlen)
 {
-	struct var_item *v;
-	int err = 0;
-
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
-	{
-		switch (v->type)
-		{
-		case VAR_TYPE_STR:
-		case VAR_TYPE_NUM:
-			if (strcmp(v->data, value) == 0) err = 1;
-		}
-	}
-	lock_unlock(&var_list_lock);
-	
-	return err;
+	return _v_stage_add((struct var_stage *)ctx, name, nlen, value, vlen);
 }
 
 
 /******************************************************************************/
 /**
- * Compare variable value to given integer value.
- *
- * @param list List ID which to used in search.
- * @param name Name of data string to get.
- * @param value Value to be compared against.
- * @return 1 if value is same, zero if it's not.
+ * Internal help routine: Worker of varl_files_parallel(), parses files
+ * until there are no more files left.
  */
-int varl_is_num(var_list_t list, char *name, double value)
+static void *_v_stage_worker(void *p)
 {
-	struct var_item *v;
-	int err = 0;
-	
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+	struct var_stage_pool *pool = (struct var_stage_pool *)p;
+	struct var_stage *st;
+	size_t i;
+
+	while ((i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED)) < pool->count)
 	{
-		switch (v->type)
-		{
-		case VAR_TYPE_STR:
-		case VAR_TYPE_NUM:
-			if (atof(v->data) == value) err = 1;
-		}
+		st = &pool->stage[i];
+		st->err = _v_file_scan(st->file, st, _v_stage_list, _v_stage_var);
+		pthread_mutex_lock(&pool->mutex);
+		st->done = 1;
+		pthread_cond_broadcast(&pool->cond);
+		pthread_mutex_unlock(&pool->mutex);
 	}
-	lock_unlock(&var_list_lock);
-	
-	return err;
+
+	return NULL;
 }
 
 
 /******************************************************************************/
 /**
- * Compare variable value to given integer value.
+ * Internal help routine: Set parsed file to lists.
+ * Variables of each list are set at once with varl_set_many(), so list
+ * is locked only once for them.
  *
- * @param list List ID which to used in search.
- * @param name Name of data string to get.
- * @param value Value to be compared against.
- * @return 1 if value is same, zero if it's not.
+ * @return 0 on success, -1 on errors.
  */
-int varl_is_int(var_list_t list, char *name, int value)
+static int _v_stage_merge(struct var_stage *st)
 {
-	struct var_item *v;
+	const char **names, **values;
+	var_list_t list = 0;
+	size_t i, n;
 	int err = 0;
-	
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+
+	if (st->line_c < 1) return 0;
+	names = (const char **)malloc(sizeof(*names) * st->line_c);
+	values = (const char **)malloc(sizeof(*values) * st->line_c);
+	if (!names || !values) goto out_err;
+
+	for (i = 0, n = 0; i <= st->line_c; i++)
 	{
-		switch (v->type)
+		if (i < st->line_c && st->line[i].value != (size_t)-1)
 		{
-		case VAR_TYPE_STR:
-		case VAR_TYPE_NUM:
-			if (atoi(v->data) == value) err = 1;
+			names[n] = &st->b.p[st->line[i].name];
+			values[n] = &st->b.p[st->line[i].value];
+			n++;
+			continue;
 		}
+		/* List changes or file ends, set variables of previous list. */
+		if (n > 0 && varl_set_many(list, names, values, n)) err = -1;
+		n = 0;
+		if (i < st->line_c) list = varl_new(&st->b.p[st->line[i].name]);
 	}
-	lock_unlock(&var_list_lock);
-	
+	goto out;
+
+out_err:
+	err = -1;
+out:
+	if (names) free(names);
+	if (values) free(values);
 	return err;
 }
 
 
 /******************************************************************************/
-/**
- * Check whether variable has some content or is empty.
- * Variable is defined as empty also, if it is not found at all.
- * In case of different types, empty means following:
- * <br>ascii: if string length is 0, then return empty.
- * <br>numeric: returns always not empty.
- * <br>binary: if data length is less than 1.
- *
- * @param list List ID which to used in search.
- * @param name Name of data string to get.
- * @return 0 if variable is non-empty string, 1 if it is empty.
- */
-int varl_is_empty(var_list_t list, char *name)
+int varl_files_parallel(const char **files, size_t count, int threads)
 {
-	struct var_item *v;
-	int err = 1;
+	struct var_stage_pool pool;
+	struct var_stage *st;
+	pthread_t *t = NULL;
+	size_t i;
+	int n = 0, err = 0;
 
-	if (list < 0 || list >= var_list_c) return 1;
-	
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1 || !files) return -1;
+	if (count < 1) return 0;
+	if (threads < 1) threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if (threads < 1) threads = 1;
+	if ((size_t)threads > count) threads = (int)count;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.stage = (struct var_stage *)calloc(count, sizeof(*pool.stage));
+	t = (pthread_t *)malloc(sizeof(*t) * threads);
+	if (!pool.stage || !t) goto out_err;
+	for (i = 0; i < count; i++) pool.stage[i].file = files[i];
+	pool.count = count;
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	for (n = 0; n < threads; n++)
 	{
-		switch (v->type)
-		{
-		case VAR_TYPE_STR:
-		case VAR_TYPE_NUM:
-			if (strlen(v->data) > 0) err = 0;
-		}
+		if (pthread_create(&t[n], NULL, _v_stage_worker, &pool)) break;
 	}
-	lock_unlock(&var_list_lock);
-	
+	/* Parse in this thread, if no worker could be started. */
+	if (n < 1) _v_stage_worker(&pool);
+
+	/* Set files in given order as they get parsed, so that last file wins like when loading one by one. */
+	for (i = 0; i < count; i++)
+	{
+		st = &pool.stage[i];
+		pthread_mutex_lock(&pool.mutex);
+		while (!st->done) pthread_cond_wait(&pool.cond, &pool.mutex);
+		pthread_mutex_unlock(&pool.mutex);
+
+		if (st->err || _v_stage_merge(st)) err = -1;
+		_v_stage_free(st);
+	}
+
+	while (n > 0) pthread_join(t[--n], NULL);
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.mutex);
+	goto out;
+
+out_err:
+	err = -1;
+out:
+	if (pool.stage) free(pool.stage);
+	if (t) free(t);
 	return err;
 }
 
 
 /******************************************************************************/
 /**
- * Return 1 if the contents can be defined as "true". 0 (false) otherwise.
- * If the item is binary, false is returned always. Also if the item
- * does not exists, false is returned.
- *
- * <br>Contents can be defined as true in following cases:
- * <br>The item is numerical and has value other than zero.
- * <br>The item is string and the content is not empty string nor "0"
+ * Internal help routine: Index variables of parsed file by list name and
+ * key. Later variable with same list and key replaces earlier one, like
+ * when file is loaded.
  *
- * @param list List ID which to used in search.
- * @param name Variable identifier key.
- * @return Length of the variables string presentation.
+ * @param size Set to size of returned index, always power of 2.
+ * @return Index, or NULL on errors.
  */
-int varl_is(var_list_t list, char *name)
+static struct var_diff *_v_diff_index(struct var_stage *st, size_t *size)
 {
-	struct var_item *v;
-	int err = 0;
-	
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+	struct var_diff *d, *e;
+	const char *list = var_empty_string, *key;
+	unsigned int hash;
+	size_t i, j;
+
+	for (*size = VAR_HASH_MIN_SIZE; *size < st->line_c * 2; *size *= 2);
+	d = (struct var_diff *)calloc(*size, sizeof(*d));
+	if (!d) return NULL;
+
+	for (i = 0; i < st->line_c; i++)
 	{
-		switch (v->type)
+		key = &st->b.p[st->line[i].name];
+		if (st->line[i].value == (size_t)-1)
 		{
-		case VAR_TYPE_STR:
-			if (strlen(v->data) < 1) err = 0;
-			else if (strcmp(v->data, "0") == 0) err = 0;
-			else err = 1;
-			break;
-		case VAR_TYPE_NUM:
-			err = (atof(v->data) == 0.0f) ? 0 : 1;
-			break;
-		default:
-			err = 0;
-			break;
+			list = key;
+			continue;
 		}
-	}
-	lock_unlock(&var_list_lock);
-	
-	return err;
+		hash = _v_hash(list) * 31 + _v_hash(key);
+		for (j = hash & (*size - 1); ; j = (j + 1) & (*size - 1))
+		{
+			e = &d[j];
+			if (!e->key || (e->hash == hash && !strcmp(e->key, key) && !strcmp(e->list, list))) break;
+		}
+		e->list = list;
+		e->key = key;
+		e->value = &st->b.p[st->line[i].value];
+		e->hash = hash;
+	}
+
+	return d;
 }
 
 
 /******************************************************************************/
 /**
- * Set variable as true. Same as setting value to (int)1.
+ * Internal help routine: Find variable from index of parsed file.
  *
- * @param list List ID which to used in search.
- * @param key Variable identifier key.
+ * @return Variable, or NULL if not found.
  */
-void varl_true(var_list_t list, char *key)
+static struct var_diff *_v_diff_find(struct var_diff *d, size_t size, const char *list, const char *key)
 {
-	varl_set_num(list, key, (double)1);
-}
+	unsigned int hash = _v_hash(list) * 31 + _v_hash(key);
+	size_t j;
 
+	for (j = hash & (size - 1); d[j].key; j = (j + 1) & (size - 1))
+	{
+		if (d[j].hash == hash && !strcmp(d[j].key, key) && !strcmp(d[j].list, list)) return &d[j];
+	}
 
-/******************************************************************************/
-/**
- * Set variable as false. Same as setting value to (int)0.
- *
- * @param list List ID which to used in search.
- * @param key Variable identifier key.
- */
-void varl_false(var_list_t list, char *key)
-{
-	varl_set_num(list, key, (double)0);
+	return NULL;
 }
 
 
 /******************************************************************************/
 /**
- * Return length of the variable, if it is a string. Error (-1) otherwise.
+ * Internal help routine: Find variable from other watched files than
+ * given one. Files watched later win, like when loading them one by one.
+ * @note Caller must hold var_watch_lock.
  *
- * @param list List ID which to used in search.
- * @param name Name of data string to get.
- * @return Length of the variables string presentation.
+ * @param later Find only from files watched after given one.
+ * @return Variable from last file having it, or NULL if not found.
  */
-int varl_strlen(var_list_t list, char *name)
+static struct var_diff *_v_watch_other(struct var_watch *w, const char *list, const char *key, int later)
 {
-	struct var_item *v;
-	int err = 0;
-	
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (v)
+	struct var_diff *d;
+	size_t i;
+
+	for (i = var_watch_c; i-- > 0; )
 	{
-		switch (v->type)
+		if (&var_watches[i] == w)
 		{
-		case VAR_TYPE_STR:
-		case VAR_TYPE_NUM:
-			err = strlen(v->data);
-			break;
-		default:
-			err = -1;
-			break;
+			if (later) break;
+			continue;
 		}
+		if (!var_watches[i].index) continue;
+		d = _v_diff_find(var_watches[i].index, var_watches[i].index_size, list, key);
+		if (d) return d;
 	}
-	lock_unlock(&var_list_lock);
-	
-	return err;
+
+	return NULL;
 }
 
 
 /******************************************************************************/
 /**
- * Parse variable into buffer.
+ * Internal help routine: Apply changes between two parses of watched file
+ * to variables merged from all watched files. Only variables which were
+ * added or which value changed are set, unless file watched later has
+ * them. Variables no longer in file get value from last other file that
+ * has them, or are removed from their lists if none has.
+ * @note Caller must hold var_watch_lock.
  *
- * @param list List ID which to search for the variable.
- * @param name Name of variable.
- * @param lists List IDs, which are used when searhing variables in string.
- * @param lc Number of items in lists.
- * @return Allocated pointer to parsed string.
- *         Must be freed after usage.
- *         Returns empty string on errors also.
+ * @param w Watched file, with index of file as it was loaded before.
+ * @param st File as it is now.
+ * @param nd Index of file as it is now.
+ * @param ns Size of index.
+ * @return Count of variables set or removed.
  */
-const char *varl_parsev(var_list_t list, char *name, int *lists, int lc)
+static int _v_stage_diff(struct var_watch *w, struct var_stage *st, struct var_diff *nd, size_t ns)
 {
-	int i;
-	char *result = NULL;
-	struct var_item *v;
-	struct var_list l;
-
-	/* Return, if lib not initialized yet. */
-	if (!var_list) return var_empty_string;
-	/* Return, if name is invalid. */
-	if (!name) return var_empty_string;
+	struct var_diff *od = w->index, *o, *d;
+	const char *list = var_empty_string, *key, *value;
+	size_t os = w->index_size, i;
+	var_list_t l = 0;
+	int changes = 0;
+
+	/* Set new and changed variables, in order they are in file. */
+	for (i = 0; i < st->line_c; i++)
+	{
+		key = &st->b.p[st->line[i].name];
+		if (st->line[i].value == (size_t)-1)
+		{
+			list = key;
+			l = -2;
+			continue;
+		}
+		/* Only last of variables with same name counts. */
+		value = &st->b.p[st->line[i].value];
+		if (_v_diff_find(nd, ns, list, key)->value != value) continue;
+		o = od ? _v_diff_find(od, os, list, key) : NULL;
+		if (o) o->seen = 1;
+		if (o && !strcmp(o->value, value)) continue;
+		if (_v_watch_other(w, list, key, 1)) continue;
+
+		if (l == -2) l = varl_new((char *)list);
+		_v_list_set(l, key, (void *)value, strlen(value) + 1, VAR_TYPE_STR);
+		changes++;
+	}
 
-	lock_read(&var_list_lock);
-	v = _v_find(list, name);
-	if (!v) goto out_err;
-	
-	/* Parse variable content. */
-	memset(&l, 0, sizeof(l));
-	result = _v_parse(v, &l, lists, lc);
+	/* Remove variables no longer in file, unless other files have them. */
+	for (i = 0; od && i < os; i++)
+	{
+		if (!od[i].key || od[i].seen || _v_watch_other(w, od[i].list, od[i].key, 1)) continue;
+		l = varl_find((char *)od[i].list);
+		if (l < 0) continue;
+		d = _v_watch_other(w, od[i].list, od[i].key, 0);
+		if (d) _v_list_set(l, d->key, (void *)d->value, strlen(d->value) + 1, VAR_TYPE_STR);
+		else varl_rm(l, od[i].key);
+		changes++;
+	}
 
-out_err:
-	lock_unlock(&var_list_lock);
-	if (!result) result = var_empty_string;
-	return result;
+	return changes;
 }
 
 
 /******************************************************************************/
 /**
- * Parse variable into buffer.
+ * Internal help routine: Reload watched file and apply changes.
+ * @note Caller must hold var_watch_lock.
  *
- * @param list List ID which to search for the variable.
- * @param name Name of variable.
- * @param argv List IDs, which are used when searhing variables in string.
-               End list with -1, or if this is the only ID given,
-               then all lists are used.
- * @return Return result, or 0 on errors.
+ * @return Count of variables set or removed, or -1 on errors.
  */
-const char *varl_parse(var_list_t list, char *name, void *argv, ...)
+static int _v_watch_reload(struct var_watch *w)
 {
-	int lc, *lists, all, i;
-	const char *result = NULL;
-	
-	/* Calculate lists count. */
-	for (lc = 0; (long)((&argv)[lc]) != -1; lc++);
+	struct var_stage st;
+	struct var_diff *nd;
+	size_t ns;
+	int changes;
 
-	/* If no lists, then use all. */
-	if (lc < 1)
-	{
-		all = -1;
-		lists = &all;
-		lc = 1;
-	}
-	/* Retrieve lists, if given. */
-	else 
+	memset(&st, 0, sizeof(st));
+	if (_v_file_scan(w->path, &st, _v_stage_list, _v_stage_var) || !(nd = _v_diff_index(&st, &ns)))
 	{
-		all = 0;
-		lists = (int *)malloc(sizeof(*lists) * lc);
-		if (!lists) goto out_err;
-		for (i = 0; i < lc; i++) lists[i] = (int)((&argv)[i]);
+		_v_stage_free(&st);
+		return -1;
 	}
-
-	/* Parse variable content. */
-	result = varl_parsev(list, name, lists, lc);
-	
-out_err:
-	if (lists && !all) free(lists);
-	if (!result) result = var_empty_string;
-	return result;
+	changes = _v_stage_diff(w, &st, nd, ns);
+
+	_v_stage_free(&w->stage);
+	if (w->index) free(w->index);
+	w->stage = st;
+	w->index = nd;
+	w->index_size = ns;
+	return changes;
 }
 
 
 /******************************************************************************/
-/**
- * First parse, then calculate variable and return result.
- *
- * @param list List ID which to search for the variable.
- * @param name Name of variable.
- * @param argv List IDs, which are used when searhing variables in string.
- *             End list with -1, or if this is the only ID given,
- *             then all lists are used.
- * @return Return result, or 0 on errors.
- */
-double varl_calc(var_list_t list, char *name, void *argv, ...)
+int var_watch_file(const char *file)
 {
-	int lc, *lists, all, i;
-	const char *res = NULL;
-	double result = 0.0F;
-	
-	/* Calculate lists count. */
-	for (lc = 0; (long)((&argv)[lc]) != -1; lc++);
+	struct var_watch *w;
+	char *dir, *slash;
+	size_t size;
+	int err = -1;
 
-	/* If no lists, then use all. */
-	if (lc < 1)
+	/* Return error, if lib not initialized yet. */
+	if (_v_lists() < 1 || !file) return -1;
+
+	lock_write(&var_watch_lock);
+
+	if (var_watch_inotify < 0)
 	{
-		all = -1;
-		lists = &all;
-		lc = 1;
+		var_watch_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (var_watch_inotify < 0) goto out_err;
 	}
-	/* Retrieve lists, if given. */
-	else 
+	if (var_watch_c >= var_watch_size)
 	{
-		all = 0;
-		lists = (int *)malloc(sizeof(int) * lc);
-		if (!lists) goto out_err;
-		for (i = 0; i < lc; i++) lists[i] = (int)((&argv)[i]);
+		size = var_watch_size ? var_watch_size * 2 : VAR_HASH_MIN_SIZE;
+		w = (struct var_watch *)realloc(var_watches, sizeof(*w) * size);
+		if (!w) goto out_err;
+		var_watches = w;
+		var_watch_size = size;
 	}
 
-	/* Parse variable content. */
-	res = varl_parsev(list, name, lists, lc);
-
-	/* Calculate it's value. */
-	result = strmath_calc(res, NULL);
+	w = &var_watches[var_watch_c];
+	memset(w, 0, sizeof(*w));
+	w->path = strdup(file);
+	if (!w->path) goto out_err;
+	slash = strrchr(w->path, '/');
+	w->name = slash ? slash + 1 : w->path;
+
+	/* Watch directory, editors often replace file instead of writing it. */
+	dir = slash ? strndup(w->path, slash > w->path ? slash - w->path : 1) : strdup(".");
+	if (dir) w->wd = inotify_add_watch(var_watch_inotify, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (dir) free(dir);
+	/* File is watched last, so its variables win those of other files. */
+	var_watch_c++;
+	if (!dir || w->wd < 0 || _v_watch_reload(w) < 0)
+	{
+		var_watch_c--;
+		_v_watch_free(w);
+		goto out_err;
+	}
+	err = 0;
 
 out_err:
-	if (res) free(res);
-	if (lists && !all) free(lists);
-	return result;
+	lock_unlock(&var_watch_lock);
+	return err;
 }
 
 
 /******************************************************************************/
-/**
- * Free given data.
- *
- * @param ptr Pointer to data to be freed.
- */
-void varl_free(void *ptr)
+void var_unwatch_file(const char *file)
 {
-	/* If NULL pointer somewhy given. */
-	if (!ptr) return;
-	/* If pointer is internal empty string pointer. */
-	if (ptr == var_empty_string) return;
-	free(ptr);
+	size_t i, j;
+	int wd;
+
+	if (_v_lists() < 1 || !file) return;
+
+	lock_write(&var_watch_lock);
+	for (i = 0; i < var_watch_c; i++)
+	{
+		if (strcmp(var_watches[i].path, file) != 0) continue;
+		wd = var_watches[i].wd;
+		_v_watch_free(&var_watches[i]);
+		/* Order of files is kept, it tells which file wins. */
+		memmove(&var_watches[i], &var_watches[i + 1], sizeof(*var_watches) * (--var_watch_c - i));
+
+		/* Directory might still have other watched files. */
+		for (j = 0; j < var_watch_c && var_watches[j].wd != wd; j++);
+		if (j >= var_watch_c) inotify_rm_watch(var_watch_inotify, wd);
+		break;
+	}
+	lock_unlock(&var_watch_lock);
 }
 
 
 /******************************************************************************/
-int varl_file(const char *file, void *lists)
+int var_watch_fd(void)
 {
-	return varl_file_prefunc(file, lists, NULL);
+	return var_watch_inotify;
 }
 
 
 /******************************************************************************/
-int varl_file_prefunc(const char *file, void *lists,
-	int (*prefunc)(var_list_t, const char *, const char *))
+int var_watch_process(void)
 {
-	FILE *f;
-	char *line = NULL, *cur, *name, *value, *middle, *varval;
-	ssize_t n = 0;
-	int err = 0;
-	var_list_t list = 0;
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t n;
+	size_t i;
+	char *p;
+	int reloaded = 0, err = 0;
 
-	/* Open file. */
-	if (!file) return -1;
-	f = fopen(file, "r");
-	if (!f) return -1;
+	if (_v_lists() < 1) return -1;
+
+	lock_write(&var_watch_lock);
+	if (var_watch_inotify < 0) goto out;
 
-	for (line = NULL, n = 0, list = 0; ; )
+	/* Mark changed files first, file can have many events. */
+	while ((n = read(var_watch_inotify, buf, sizeof(buf))) > 0)
 	{
-		/* Get new line from stream. */
-		err = getline(&line, &n, f);
-		if (err < 1) break;
-		
-		/* Trim line. */
-		cur = _v_trim(line);
-		if (strlen(cur) < 1) continue;
-		
-		/* Dont parse commented lines. */
-		if (*cur == '#') continue;
-		
-		/* Parse new list. */
-		if (*cur == '[')
-		{
-			err = sscanf(cur, "[%a[^]\n]", &name);
-			if (err == 1)
-			{
-				//printf("%d, %s\n", err, name);
-				list = varl_new(name);
-				free(name);
-			}
-			continue;
-		}
-		
-		/* Parse variable. */
-		name = NULL; middle = NULL; value = NULL;
-		err = sscanf(cur, "%a[^ =\t\n]%a[ =\t]%a[^\n]", &name, &middle, &value);
-		if (err == 3 && strchr(middle, (int)'='))
+		for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len)
 		{
-			err = (int)value[0];
-			if (err == '\"' || err == '\'')
+			ev = (const struct inotify_event *)p;
+			/* Events were lost, any file might have changed. */
+			if (ev->mask & IN_Q_OVERFLOW)
 			{
-				varval = strchr(value + 1, err);
-				if (varval)
-				{
-					varval[0] = '\0';
-					varval = value + 1;
-				}
-				else varval = value;
+				for (i = 0; i < var_watch_c; i++) var_watches[i].changed = 1;
+				continue;
 			}
-			else varval = value;
-
-			int done = 0;
-			if (prefunc)
-			{
-				done = prefunc(list, name, varval);
-			}
-//			printf("%d, %s = %s\n", err, name, varval);
-			if (!done)
+			if (ev->len < 1) continue;
+			for (i = 0; i < var_watch_c; i++)
 			{
-				varl_set_str(list, name, varval);
+				if (var_watches[i].wd == ev->wd && !strcmp(var_watches[i].name, ev->name)) var_watches[i].changed = 1;
 			}
 		}
-		if (name) free(name);
-		if (middle) free(middle);
-		if (value) free(value);
 	}
 
-	fclose(f);
-	if (line) free(line);
-	return 0;
+	for (i = 0; i < var_watch_c; i++)
+	{
+		if (!var_watches[i].changed) continue;
+		if (_v_watch_reload(&var_watches[i]) < 0) err = -1;
+		else reloaded++;
+		var_watches[i].changed = 0;
+	}
+
+out:
+	lock_unlock(&var_watch_lock);
+	return err ? -1 : reloaded;
+}
+
+
+/******************************************************************************/
+int varl_file(const char *file, void *lists)
+{
+	return varl_file_prefunc(file, lists, NULL);
+}
+
+
+/******************************************************************************/
+int varl_file_prefunc(const char *file, void *lists,
+	int (*prefunc)(var_list_t, const char *, const char *))
+{
+	return _v_file(file, prefunc, NULL);
+}
+
+
+/******************************************************************************/
+int varl_file_prefunc_n(const char *file, void *lists,
+	int (*prefunc)(var_list_t, const char *, size_t, const char *, size_t))
+{
+	return _v_file(file, NULL, prefunc);
 }
 
 
 /******************************************************************************/
 int varl_count(var_list_t index)
 {
-	if (index >= var_list_c || index < 0) return 0;
-	return var_list[index].count;
+	int count;
+
+	if (index >= _v_lists() || index < 0) return 0;
+	_v_lock_read(&_v_list(index)->lock, &_v_list(index)->stats.lock_wait_ns);
+	count = _v_list(index)->count;
+	lock_unlock(&_v_list(index)->lock);
+
+	return count;
+}
+
+
+/******************************************************************************/
+int varl_length(var_list_t list)
+{
+	struct var_list *l;
+	int length;
+
+	if (list >= _v_lists() || list < 0) return 0;
+	l = _v_list(list);
+	_v_lock_read(&l->lock, &l->stats.lock_wait_ns);
+	length = (int)l->slot_c;
+	lock_unlock(&l->lock);
+
+	return length;
 }
 
 
 /******************************************************************************/
 void varl_reset(var_list_t list)
 {
-	if (list >= var_list_c || list < 0) return;
-	lock_write(&var_list_lock);
-	struct var_list *l = &var_list[list];
-	l->current = l->first;
-	lock_unlock(&var_list_lock);
+	if (list >= _v_lists() || list < 0) return;
+	struct var_list *l = _v_list(list);
+	if (_v_lock_list(l)) return;
+	l->current = _v_next(l, &l->current_layer, NULL);
+	lock_unlock(&l->lock);
 }
 
 
 /******************************************************************************/
 char *varl_each(var_list_t list, int *type, void **value, size_t *size)
 {
-	char *key = NULL;
+	char *key = NULL, *str;
+	size_t n;
 
-	lock_write(&var_list_lock);
-	struct var_list *l = &var_list[list];
+	if (list >= _v_lists() || list < 0) return NULL;
+	struct var_list *l = _v_list(list);
+	if (_v_lock_list(l)) return NULL;
 	if (!l->current)
 	{
-		l->current = l->first;
+		l->current = _v_next(l, &l->current_layer, NULL);
 	}
 	else
 	{
 		key = strdup(l->current->key);
 		if (type) *type = l->current->type;
+		/* Numbers are given in their string form. */
+		str = _v_str(l->current->type, l->current->data);
+		n = (str && VAR_TYPE_IS_NUM(l->current->type)) ? strlen(str) + 1 : l->current->size;
+		if (!str || !VAR_TYPE_IS_NUM(l->current->type)) str = l->current->data;
 		if (value)
 		{
-			*value = malloc(l->current->size);
-			memcpy(*value, l->current->data, l->current->size);
+			*value = malloc(n);
+			if (*value && str) memcpy(*value, str, n);
 		}
-		if (size) *size = l->current>size;
-		l->current = l->current->next;
+		if (size) *size = n;
+		l->current = _v_next(l, &l->current_layer, l->current);
 	}
 
-	lock_unlock(&var_list_lock);
+	lock_unlock(&l->lock);
 	return key;
 }
 
 
+/******************************************************************************/
+int varl_iter_begin(var_list_t list, struct var_iter *it)
+{
+	if (list >= _v_lists() || list < 0 || !it || var_iter_c >= VAR_ITER_MAX) return -1;
+	_v_lock_read(&_v_list(list)->lock, &_v_list(list)->stats.lock_wait_ns);
+	var_iter_lists[var_iter_c++] = _v_list(list);
+	it->list = list;
+	it->layer = NULL;
+	it->item = NULL;
+
+	return 0;
+}
+
+
+/******************************************************************************/
+int varl_iter_next(struct var_iter *it, const char **key, int *type, const void **value, size_t *size)
+{
+	struct var_item *v;
+	char *str;
+
+	v = _v_next(_v_list(it->list), &it->layer, it->item);
+	if (!v) return 0;
+	it->item = v;
+
+	if (key) *key = v->key;
+	if (type) *type = v->type;
+	/* Numbers are given in their string form. */
+	str = _v_str(v->type, v->data);
+	if (str && VAR_TYPE_IS_NUM(v->type))
+	{
+		if (value) *value = str;
+		if (size) *size = strlen(str) + 1;
+	}
+	else
+	{
+		if (value) *value = v->data;
+		if (size) *size = v->size;
+	}
+
+	return 1;
+}
+
+
+/******************************************************************************/
+void varl_iter_end(struct var_iter *it)
+{
+	struct var_list *l = _v_list(it->list);
+	int i;
+
+	for (i = var_iter_c - 1; i >= 0 && var_iter_lists[i] != l; i--);
+	if (i >= 0) var_iter_lists[i] = var_iter_lists[--var_iter_c];
+	lock_unlock(&l->lock);
+}
+
+
 /******************************************************************************/
 char **varl_get_keys(var_list_t index)
 {
 	char **result = NULL;
 	struct var_list *list = NULL;
 	struct var_item *v;
+	struct var_layer *layer;
 	int i;
 	
-	if (index >= var_list_c) return NULL;
-	lock_read(&var_list_lock);
-	list = &var_list[index];
+	if (index >= _v_lists() || index < 0) return NULL;
+	list = _v_list(index);
+	_v_lock_read(&list->lock, &list->stats.lock_wait_ns);
 	result = (char **)malloc(sizeof(char *) * list->count);
-	for (i = 0, v = list->first; v; v = (struct var_item *)v->next, i++)
+	for (i = 0, v = _v_next(list, &layer, NULL); v; v = _v_next(list, &layer, v), i++)
 	{
 		result[i] = v->key;
 	}
-	lock_unlock(&var_list_lock);
+	lock_unlock(&list->lock);
 	return result;
 }
 
@@ -1478,18 +6055,20 @@ char **varl_get_all(var_list_t index)
 	char **result = NULL;
 	struct var_list *list = NULL;
 	struct var_item *v;
+	struct var_layer *layer;
 	int i;
 
-	if (index >= var_list_c) return NULL;
-	lock_read(&var_list_lock);
-	list = &var_list[index];
+	if (index >= _v_lists() || index < 0) return NULL;
+	list = _v_list(index);
+	_v_lock_read(&list->lock, &list->stats.lock_wait_ns);
 	result = (char **)malloc(sizeof(char *) * list->count * 2);
-	for (i = 0, v = list->first; v; v = (struct var_item *)v->next, i += 2)
+	for (i = 0, v = _v_next(list, &layer, NULL); v; v = _v_next(list, &layer, v), i += 2)
 	{
 		result[i] = v->key;
-		result[i + 1] = v->data;
+		result[i + 1] = _v_str(v->type, v->data);
+		if (!result[i + 1]) result[i + 1] = v->data;
 	}
-	lock_unlock(&var_list_lock);
+	lock_unlock(&list->lock);
 	return result;
 }
 
@@ -15,6 +15,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <ddebug/synchro.h>
 
 
 /******************************************************************************/
@@ -24,6 +26,10 @@
 
 #define VAR_LIST_SIZE	(sizeof(struct var_list))
 #define VAR_ITEM_SIZE	(sizeof(struct var_item))
+/* size of item allocation including key of given length */
+#define VAR_ITEM_ALLOC(keylen)	(VAR_ITEM_SIZE + (keylen) + 1)
+/* values up to this size are stored in item itself, fits struct var_num */
+#define VAR_ITEM_SMALL	24
 
 #define VAR_TYPE_EMPTY	0
 #define VAR_TYPE_STR	1
@@ -32,12 +38,69 @@
 #define VAR_TYPE_P		4
 #define VAR_TYPE_INT	5
 
+/* whether type is stored as struct var_num */
+#define VAR_TYPE_IS_NUM(t) ((t) == VAR_TYPE_NUM || (t) == VAR_TYPE_INT)
+
 #define VAR_CHARS		"$"
 #define VAR_BREAK		" .+$\n"
 #define VAR_SPECIAL		"$"
 
 #define VAR_MIN_MALLOC	MAX_STRING
 
+/* initial size of list hash index, must be power of 2 */
+#define VAR_HASH_MIN_SIZE	16
+
+/* lists are stored in chunks, first chunk has VAR_LIST_CHUNK_MIN lists */
+#define VAR_LIST_CHUNK_MIN	64
+#define VAR_LIST_CHUNKS		26
+
+/* list flags for varl_new_flags() */
+#define VAR_LIST_ARENA	0x01
+/* internal, list has no ID and is not cached, see var_overlay_begin() */
+#define VAR_LIST_LOCAL	0x02
+/* internal, set for global index of keys, which has no prefix tree */
+#define VAR_LIST_INDEX	0x04
+#define VAR_LIST_ARRAY	0x08
+
+/* item flags */
+#define VAR_ITEM_ARENA	0x01
+/* item hides item with same name in base of list, see varl_cp() */
+#define VAR_ITEM_DELETED	0x02
+/* small buffer of item has number, which might have string form */
+#define VAR_ITEM_SMALL_NUM	0x04
+/* internal, item is in list or hash index of snapshot list being checked, or in checked list */
+#define VAR_ITEM_SNAP_LIST	0x08
+#define VAR_ITEM_SNAP_HASH	0x10
+#define VAR_ITEM_SNAP_DONE	0x20
+
+/* snapshot file format, see var_save_snapshot() */
+#define VAR_SNAPSHOT_MAGIC		"STRVARS"
+#define VAR_SNAPSHOT_VERSION	1
+/* snapshot is saved for this address and restored without relocating if mapped there */
+#define VAR_SNAPSHOT_BASE		(sizeof(void *) > 4 ? (uintptr_t)0x200000000000ULL : (uintptr_t)0x40000000UL)
+
+/* base of list is flattened when copying list with deeper base */
+#define VAR_LAYER_DEPTH_MAX	8
+
+/* retired memory of list is tried to be freed every this many retires */
+#define VAR_RETIRE_BATCH	64
+
+/* global index of keys is split to stripes by hash of key, each locked separately */
+#define VAR_KEYS_STRIPE_BITS	6
+#define VAR_KEYS_STRIPES		(1 << VAR_KEYS_STRIPE_BITS)
+/* IDs of lists having a key are updated in stack buffer up to this count */
+#define VAR_KEYS_STACK			16
+
+/* cursors of varl_iter_begin() one thread can have at once */
+#define VAR_ITER_MAX			8
+
+/* adding and removing items is counted by hash of key in this many slots, must be power of 2 */
+#define VAR_KEY_VERSIONS		4096
+
+/* size of arena blocks and alignment of allocations carved from them */
+#define VAR_ARENA_BLOCK_SIZE	65536
+#define VAR_ARENA_ALIGN			8
+
 enum
 {
 	/* whether to expand variables in variables */
@@ -54,12 +117,160 @@ enum
  */
 struct var_item
 {
-	char key[260];
-	int type;
-	void *data;
-	size_t size;
 	struct var_item *next;
 	struct var_item *prev;
+	/* next item in same hash index slot */
+	struct var_item *hash_next;
+	void *data;
+	size_t size;
+	int type;
+	unsigned int flags;
+	/* odd while data, size, type and tmpl are being changed */
+	unsigned int seq;
+	/* compiled template of string value, stored after the string */
+	struct var_tmpl *tmpl;
+	/* last parse result of this item */
+	struct var_memo *memo;
+	/* small value stored in item, data points here when used */
+	char small[VAR_ITEM_SMALL];
+	/* epoch when small value was replaced, 0 if small was never used */
+	unsigned long small_epoch;
+	/* hash of key */
+	unsigned int hash;
+	/* length of key, key is stored null terminated right after the item */
+	unsigned int keylen;
+	char key[];
+};
+/* value of VAR_TYPE_NUM and VAR_TYPE_INT items */
+struct var_num
+{
+	double num;
+	int i;
+	/* string form of number, formatted when first asked */
+	char *str;
+};
+/*
+ * token of compiled template, either text or reference to variable,
+ * last resolved item of reference is cached while no items with the
+ * same key are added or removed, cache is guarded by cache_seq
+ */
+struct var_tmpl_tok
+{
+	const char *str;
+	size_t len;
+	int ref;
+	unsigned int hash;
+	unsigned int cache_seq;
+	int cache_list;
+	unsigned long cache_version;
+	unsigned int cache_key_version;
+	struct var_item *cache_item;
+};
+/* template compiled from string value with references to variables */
+struct var_tmpl
+{
+	size_t count;
+	struct var_tmpl_tok tok[];
+};
+/*
+ * parse result of item, valid while none of the items it was parsed from
+ * are set, removed or hidden, and no item is added with key of reference
+ * that was not found, dependency on missing key has NULL item
+ */
+struct var_memo_dep
+{
+	struct var_item *item;
+	unsigned int seq;
+	unsigned int hash;
+	unsigned int key_version;
+};
+struct var_memo
+{
+	unsigned long version;
+	int list;
+	/* set if parsing stopped to recursion */
+	int cut;
+	size_t len;
+	char *str;
+	size_t count;
+	struct var_memo_dep dep[];
+};
+/*
+ * node of prefix tree of item keys, label is not null terminated,
+ * siblings start with different characters
+ */
+struct var_trie
+{
+	struct var_trie *child;
+	struct var_trie *next;
+	/* item which key ends to this node, or NULL */
+	struct var_item *item;
+	size_t len;
+	char label[];
+};
+struct var_arena_block
+{
+	struct var_arena_block *next;
+	size_t size;
+	size_t used;
+	char data[];
+};
+/* memory removed from list, freed when no reader can see it anymore */
+struct var_retire
+{
+	void *p;
+	void (*f)(void *);
+	unsigned long epoch;
+};
+/* snapshot file mapped to memory, shared by layers restored from it */
+struct var_image
+{
+	void *map;
+	size_t size;
+	unsigned int refs;
+};
+/*
+ * items moved from list when list was copied, shared by list and its
+ * copies until last of them releases it, items in layer are never changed
+ */
+struct var_layer
+{
+	struct var_item *first;
+	struct var_item **hash;
+	size_t hash_size;
+	struct var_trie *trie;
+	struct var_arena_block *arena;
+	/* set if items are in snapshot file, see var_load_snapshot() */
+	struct var_image *image;
+	/* older layer under this one, or NULL */
+	struct var_layer *base;
+	int depth;
+	unsigned int refs;
+};
+typedef int var_list_t;
+/* counters of one list, see varl_stats() */
+struct var_list_stats
+{
+	/* lookups from list and lookups that did not find item */
+	uint64_t gets;
+	uint64_t misses;
+	uint64_t sets;
+	/* items compared while looking up */
+	uint64_t scanned;
+	/* nanoseconds waited for lock of list */
+	uint64_t lock_wait_ns;
+};
+/* counters of all lists, see var_stats() */
+struct var_stats
+{
+	int lists;
+	/* sum of counters of all lists */
+	struct var_list_stats total;
+	/* templates expanded and parse results reused from memos */
+	uint64_t expands;
+	uint64_t memo_hits;
+	/* nanoseconds waited for lock of list array */
+	uint64_t list_lock_wait_ns;
 };
 struct var_list
 {
@@ -67,10 +278,51 @@ struct var_list
 	struct var_item *first;
 	struct var_item *last;
 	struct var_item *current;
+	/* layer of current item, or NULL if it is in list itself */
+	struct var_layer *current_layer;
+	/* count of items visible in list, including base */
 	size_t count;
+	/* count of items in list itself, not including base */
+	size_t own_count;
 	int auto_array_counter;
+	/* items by index, when list is created with VAR_LIST_ARRAY */
+	struct var_item **slot;
+	size_t slot_size;
+	/* one past largest index set, index of next appended item */
+	size_t slot_c;
+	/* hash index of items, hash_size is always power of 2 */
+	struct var_item **hash;
+	size_t hash_size;
+	/* odd while hash index is being replaced */
+	unsigned int hash_seq;
+	/* prefix tree of keys, guarded by lock */
+	struct var_trie *trie;
+	/* hash of name and next list in same list name index slot, or -1 */
+	unsigned int name_hash;
+	var_list_t name_next;
+	/* ID of list, -1 for internal lists */
+	var_list_t id;
+	int flags;
+	/* memory blocks when list is created with VAR_LIST_ARENA */
+	struct var_arena_block *arena;
+	/* items shared with copies of list, see varl_cp() */
+	struct var_layer *base;
+	/* lock for writers of this list, readers do not lock */
+	lock_t lock;
+	struct var_retire *retired;
+	size_t retired_c;
+	size_t retired_size;
+	/* counted only when compiled with --enable-stats */
+	struct var_list_stats stats;
+};
+/* cursor of varl_iter_begin(), owned by caller */
+struct var_iter
+{
+	var_list_t list;
+	/* layer of item, or NULL if it is in list itself */
+	struct var_layer *layer;
+	struct var_item *item;
 };
-typedef int var_list_t;
 /** @} addtogroup strvar */
 
 
@@ -83,8 +335,81 @@ typedef int var_list_t;
 int var_init(void);
 void var_quit(void);
 void var_dump(void);
+/**
+ * Get counters of all lists. Counters are collected only when library is
+ * compiled with --enable-stats, which defines VAR_STATS.
+ *
+ * @param stats Counters are set to this.
+ * @return 0 on success, -1 if not compiled with statistics.
+ */
+int var_stats(struct var_stats *stats);
+/**
+ * Get counters of single list, see var_stats().
+ *
+ * @return 0 on success, -1 on errors or if not compiled with statistics.
+ */
+int varl_stats(var_list_t list, struct var_list_stats *stats);
+/**
+ * Set all counters to zero.
+ */
+void var_stats_reset(void);
+/**
+ * Print counters of var_stats() to stdout, one line for totals and one
+ * for each list, as space separated name=value fields.
+ */
+void var_dump_stats(void);
+/**
+ * Save all lists and their items to binary snapshot file, which can be
+ * restored with var_load_snapshot(). Lists are saved one at a time, each
+ * of them as it was at the time it was saved.
+ * Snapshot can only be restored by same build of the library.
+ *
+ * @param file Filename.
+ * @return 0 on success, -1 on errors.
+ */
+int var_save_snapshot(const char *file);
+/**
+ * Restore lists from snapshot file saved with var_save_snapshot().
+ * Lists are found by their names or created, and cleared before restoring.
+ * File is mapped to memory and items are used directly from there until
+ * they are set or removed, so restoring takes about the same time no
+ * matter how many items there are.
+ *
+ * @param file Filename.
+ * @return 0 on success, -1 on errors.
+ */
+int var_load_snapshot(const char *file);
+/**
+ * Begin reading lists. Reading functions like varl_get_str() do not lock,
+ * and values they return can be replaced by other threads at any time.
+ * Pointers returned by them stay valid until var_read_end() is called.
+ * Calls can be nested.
+ *
+ * @return 0 on success, -1 on errors.
+ */
+int var_read_begin(void);
+/**
+ * End reading started with var_read_begin().
+ */
+void var_read_end(void);
 #define var_free(p) free(p)
 var_list_t varl_new(char *name);
+/**
+ * As varl_new(), but create list with given flags.
+ * If list with given name already exists, it is returned as is.
+ * <br>VAR_LIST_ARENA: items and their values are allocated from large
+ * blocks owned by the list. Memory is not given back one item at a time,
+ * but all at once when list is cleared or var_quit() is called.
+ * <br>VAR_LIST_ARRAY: items named with index, like "0", "1" and so on,
+ * are also kept in array, so varl_append_str() and varl_get_at_str() and
+ * others find them without handling names. Items can still be used with
+ * their names as in any list.
+ *
+ * @param name Optional name for new variable list. Can be NULL.
+ * @param flags Flags for new list.
+ * @return Index of new list or -1 on errors.
+ */
+var_list_t varl_new_flags(char *name, int flags);
 var_list_t varl_find(char *name);
 /**
  * Rename existing list.
@@ -96,6 +421,22 @@ int varl_rename(var_list_t list, char *name);
 int varl_set_str(var_list_t, char *, char *, ...);
 int varl_set_num(var_list_t, char *, double);
 int varl_set_int(var_list_t, char *, int);
+/**
+ * As varl_set_str, but set given string as is and take ownership of it.
+ * String is stored without copying when possible, and freed by library
+ * when no longer needed. It is freed also on errors.
+ *
+ * @param list ID of list to be used.
+ * @param name Name of item to be set.
+ * @param string String allocated with malloc().
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_str_own(var_list_t list, const char *name, char *string);
+/**
+ * As varl_set_str_own, but string has given length and does not need
+ * to be null terminated.
+ */
+int varl_set_str_own_n(var_list_t list, const char *name, char *string, size_t len);
 
 /**
  * As varl_set_str, but set variable as binary data with given size.
@@ -108,6 +449,87 @@ int varl_set_int(var_list_t, char *, int);
  */
 int varl_set_bin(var_list_t list, const char *name, void *data, size_t size);
 
+/**
+ * Set many string variables at once. List is locked only once and room
+ * for new items is made at once. Values are copied as is, they are not
+ * used as format like in varl_set_str().
+ *
+ * @param list ID of list to be used, or -1 to set existing items in all lists.
+ * @param names Names of items to be set.
+ * @param values Values for items, NULL sets empty string.
+ * @param count Number of names and values.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_many(var_list_t list, const char **names, const char **values, size_t count);
+
+/**
+ * Append variable to end of list created with VAR_LIST_ARRAY. Name of
+ * variable is its index, which is one past largest index set so far.
+ *
+ * @param list ID of list to be used.
+ * @param string Format of value, as in varl_set_str().
+ * @return Index of variable, or -1 on errors.
+ */
+int varl_append_str(var_list_t list, const char *string, ...);
+int varl_append_num(var_list_t list, double num);
+int varl_append_int(var_list_t list, int num);
+/**
+ * Set variable by index. Variable is same as the one named with the
+ * index, but in lists created with VAR_LIST_ARRAY it is found without
+ * handling the name.
+ *
+ * @param list ID of list to be used.
+ * @param index Index of variable.
+ * @return Returns 0 on success, -1 on errors.
+ */
+int varl_set_at_str(var_list_t list, int index, const char *string, ...);
+int varl_set_at_num(var_list_t list, int index, double num);
+int varl_set_at_int(var_list_t list, int index, int num);
+/**
+ * Get variable by index, see varl_set_at_str() and varl_get_str().
+ * Items of array list can be gone trough by calling these with indexes
+ * from 0 up to varl_length().
+ */
+const char *varl_get_at_str(var_list_t list, int index);
+double varl_get_at_num(var_list_t list, int index);
+int varl_get_at_int(var_list_t list, int index);
+/**
+ * Get length of list created with VAR_LIST_ARRAY.
+ * Length is one past largest index set, it does not get smaller when
+ * items are removed, only when list is cleared.
+ *
+ * @return Length, or 0 on errors.
+ */
+int varl_length(var_list_t list);
+
+/**
+ * Begin thread-local overlay of calling thread. Variables set to overlay
+ * are seen only by calling thread and they hide variables with same name
+ * in given lists, when searched with varl_get_str() and others or when
+ * parsed with varl_parsev(). Overlay is not locked and parse results are
+ * not cached while it is active.
+ *
+ * @param lists IDs of lists overlay shadows, -1 shadows all lists.
+ * @param count Number of items in lists.
+ * @return 0 on success, -1 on errors.
+ */
+int var_overlay_begin(const var_list_t *lists, int count);
+/**
+ * End overlay of calling thread and remove all variables from it.
+ * Memory of overlay is kept for next var_overlay_begin(), so reset is
+ * cheap. Values got from overlay are not valid after this.
+ */
+void var_overlay_end(void);
+/**
+ * As varl_set_str(), varl_set_num() and varl_set_int(), but set variable
+ * in overlay of calling thread.
+ *
+ * @return Returns 0 on success, -1 on errors or if overlay is not active.
+ */
+int var_overlay_set_str(const char *name, const char *string, ...);
+int var_overlay_set_num(const char *name, double num);
+int var_overlay_set_int(const char *name, int num);
+
 /**
  * Remove variable. Free all memory reserved by given variable.
  *
@@ -116,10 +538,32 @@ int varl_set_bin(var_list_t list, const char *name, void *data, size_t size);
  */
 void varl_rm(var_list_t list, const char *name);
 
+/**
+ * Remove all variables from list. List itself is left intact.
+ * Arena lists release all their memory blocks at once.
+ *
+ * @param list ID of list to be used.
+ */
+void varl_clear(var_list_t list);
+
 const char *varl_get_str(var_list_t, char *);
 double varl_get_num(var_list_t, char *);
 int varl_get_int(var_list_t, char *);
 const void *varl_get_bin(var_list_t, char *, int *);
+/**
+ * Get many variables as ascii strings at once, see varl_get_str().
+ * Values are not expanded even if VAR_OPT_EXPAND is set.
+ * Call inside var_read_begin() and var_read_end() to keep values valid
+ * while using them.
+ *
+ * @param list ID of list to be used, or -1 to search all lists.
+ * @param names Names of items to get.
+ * @param values Where to store values, "" (empty string) is stored for
+ *               items not found or which cannot be converted as string.
+ * @param count Number of names and values.
+ * @return Number of items found, -1 on errors.
+ */
+int varl_get_many(var_list_t list, const char **names, const char **values, size_t count);
 
 int varl_is_str(var_list_t, char *, char *);
 int varl_is_num(var_list_t, char *, double);
@@ -193,7 +637,79 @@ int varl_file(const char *, void *);
  */
 int varl_file_prefunc(const char *, void *, int (*prefunc)(var_list_t, const char *, const char *));
 
-void varl_cp(const char *, const char *);
+/**
+ * As varl_file_prefunc(), but prefunc is given name and value as pointer
+ * and length into the file mapped to memory, so nothing is copied for
+ * it. Name and value are not null terminated.
+ *
+ * @param file Filename.
+ * @param lists Set to NULL, do not use. Reserved for future.
+ * @param prefunc Function to use filtering variables before adding them to list, or NULL.
+ *                Parameters are list, name, length of name, value and length of value.
+ *                Return non-zero, if variable should not be added to list.
+ * @return 0 on success, -1 on errors.
+ */
+int varl_file_prefunc_n(const char *file, void *lists,
+	int (*prefunc)(var_list_t, const char *, size_t, const char *, size_t));
+
+/**
+ * Load many files as with varl_file(), parsing them in parallel.
+ * Files are parsed by pool of worker threads into private buffers, and
+ * then set to lists in given order, each list locked only once per file.
+ * Result is same as calling varl_file() for each file in given order.
+ *
+ * @param files Filenames.
+ * @param count Count of files.
+ * @param threads Count of worker threads, or 0 to use one per processor.
+ * @return 0 on success, -1 if loading any of the files failed.
+ */
+int varl_files_parallel(const char **files, size_t count, int threads);
+
+/**
+ * Load file as with varl_file() and watch it for changes. Changed files
+ * are reloaded by var_watch_process(), which sets only variables that
+ * were added or changed in file and removes variables no longer in file.
+ * Variables that did not change are not touched. Variables are merged
+ * from all watched files, file watched later wins, and variable removed
+ * from one file keeps value of other file that still has it.
+ *
+ * @param file Filename.
+ * @return 0 on success, -1 on errors.
+ */
+int var_watch_file(const char *file);
+/**
+ * Stop watching file. Variables loaded from file are kept.
+ *
+ * @param file Filename given to var_watch_file().
+ */
+void var_unwatch_file(const char *file);
+/**
+ * Get file descriptor that becomes readable when watched files change,
+ * for poll() or select() loop of caller.
+ *
+ * @return File descriptor, or -1 if no files are watched.
+ */
+int var_watch_fd(void);
+/**
+ * Reload watched files that have changed. Does not block.
+ *
+ * @return Count of files reloaded, or -1 on errors.
+ */
+int var_watch_process(void);
+
+/**
+ * Copy list. Copy shares items with original list, so copying takes the
+ * same time no matter how many items list has. After copying, both lists
+ * can be read and set independently of each other. Item is duplicated
+ * only when it is set in either list, other items stay shared.
+ * Copy is created with same flags as original list.
+ *
+ * @param list List to copy.
+ * @param name Name for the copy, can be NULL. Named copy fails, if list
+ *             with given name already exists.
+ * @return Index of copy or -1 on errors.
+ */
+var_list_t varl_cp(var_list_t list, char *name);
 
 /**
  * Return count of items in list.
@@ -209,6 +725,8 @@ void varl_reset(var_list_t list);
 
 /**
  * Go trough all items in list.
+ * Key and value are copied for each item and position is stored in list,
+ * see varl_iter_begin() for iterating without copying.
  *
  * @param list List.
  * @param type Pointer where to store item type (int).
@@ -218,6 +736,42 @@ void varl_reset(var_list_t list);
  */
 char *varl_each(var_list_t list, int *type, void **value, size_t *size);
 
+/**
+ * Begin iterating list with caller owned cursor. Unlike varl_each(),
+ * nothing is copied or allocated, and any number of threads can iterate
+ * same list at the same time. List is read locked until varl_iter_end(),
+ * so writers of list wait while it is being iterated.
+ * <br>Thread iterating list must not change it before varl_iter_end(),
+ * since it would wait for itself. Such changes are refused, functions
+ * returning status return -1. Thread can have VAR_ITER_MAX cursors.
+ *
+ * @param list List.
+ * @param it Cursor to initialize.
+ * @return 0 on success, -1 on errors.
+ */
+int varl_iter_begin(var_list_t list, struct var_iter *it);
+
+/**
+ * Get next item of list being iterated.
+ * Key and value point to item itself and are valid until varl_iter_end().
+ * Numbers are given in their string form.
+ *
+ * @param it Cursor from varl_iter_begin().
+ * @param key Pointer where to store pointer to key of item, or NULL.
+ * @param type Pointer where to store item type, or NULL.
+ * @param value Pointer where to store pointer to item value, or NULL.
+ * @param size Pointer where to store item size, or NULL.
+ * @return 1 if item was found, 0 when no more items are available.
+ */
+int varl_iter_next(struct var_iter *it, const char **key, int *type, const void **value, size_t *size);
+
+/**
+ * End iterating started with varl_iter_begin().
+ *
+ * @param it Cursor from varl_iter_begin().
+ */
+void varl_iter_end(struct var_iter *it);
+
 /**
  * Get all keys in list.
  */
@@ -257,6 +811,7 @@ char **varl_get_all(var_list_t);
 
 #define var_reset() varl_reset(0)
 #define var_each(t, v, s) varl_each(0, t, v, s)
+#define var_iter_begin(it) varl_iter_begin(0, it)
 
 #define var_get_keys() varl_keys(0)
 
@@ -270,12 +825,10 @@ char **varl_get_all(var_list_t);
  * @{
  */
 void _v_free(struct var_item *);
-void _v_set(struct var_item *, void *, int, int);
+void _v_set(struct var_list *, struct var_item *, void *, int, int);
 void _v_new(struct var_item **, var_list_t, char *);
 struct var_item *_v_find(var_list_t, char *);
 int _v_list_set(var_list_t, const char *, void *, int, int);
-void _v_strcat(char **, int *, const char *, int);
-char *_v_parse(struct var_item *, struct var_list *, int *, int);
 /** @} addtogroup internal */
 
 
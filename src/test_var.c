@@ -0,0 +1,367 @@
+/*
+ * libstrvar variable list smoke tests.
+ * Part of libstrvar.
+ *
+ * License: MIT, see LICENSE
+ * Authors: Antti Partanen <aehparta@cc.hut.fi, duge at IRCnet>
+ */
+
+/******************************************************************************/
+/* INCLUDES */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "strvar.h"
+#include "strhash.h"
+#include "strllist.h"
+
+
+/******************************************************************************/
+/* VARIABLES */
+#define TEST_OLD "old value, long enough not to fit in item itself"
+#define TEST_NEW "new value, long enough not to fit in item itself"
+#define TEST(c) test_check(c, #c, __LINE__)
+static int test_failed = 0;
+static int test_stop = 0;
+static var_list_t test_list;
+static char test_dir[] = "/tmp/testvarXXXXXX";
+/* malloc() fails when this gets to zero, free() remembers what it freed */
+static int test_malloc_fail = -1;
+static void *test_freed = NULL;
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *p);
+
+
+/******************************************************************************/
+/* FUNCTIONS */
+
+/******************************************************************************/
+/**
+ * Print failed check.
+ */
+static void test_check(int ok, const char *what, int line)
+{
+	if (ok) return;
+	printf("FAILED line %d: %s\n", line, what);
+	test_failed++;
+}
+
+
+/******************************************************************************/
+/**
+ * Allocate memory, or fail on purpose, see test_malloc_fail.
+ */
+void *malloc(size_t size)
+{
+	if (test_malloc_fail > 0) test_malloc_fail--;
+	else if (test_malloc_fail == 0)
+	{
+		test_malloc_fail = -1;
+		return NULL;
+	}
+	return __libc_malloc(size);
+}
+
+
+/******************************************************************************/
+/**
+ * Free memory and remember it.
+ */
+void free(void *p)
+{
+	if (p) test_freed = p;
+	__libc_free(p);
+}
+
+
+/******************************************************************************/
+/**
+ * Write file to test directory.
+ */
+static void test_write(const char *name, const char *content)
+{
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/%s", test_dir, name);
+	f = fopen(path, "w");
+	if (!f) return;
+	fputs(content, f);
+	fclose(f);
+}
+
+
+/******************************************************************************/
+/**
+ * Thread setting same item to one of two values until told to stop.
+ */
+static void *test_setter(void *p)
+{
+	int i;
+
+	for (i = 0; !__atomic_load_n(&test_stop, __ATOMIC_ACQUIRE); i++)
+	{
+		varl_set_str(test_list, "k", "%s", (i & 1) ? TEST_OLD : TEST_NEW);
+		if (i % 100 == 0) varl_rm(test_list, "k");
+	}
+
+	return NULL;
+}
+
+
+/******************************************************************************/
+/**
+ * Values read inside var_read_begin() stay valid while other threads set them.
+ */
+static void test_read(void)
+{
+	pthread_t t[2];
+	const char *v;
+	char copy[64];
+	int i, j;
+
+	test_list = varl_new("read");
+	varl_set_str(test_list, "k", TEST_OLD);
+	for (i = 0; i < 2; i++) pthread_create(&t[i], NULL, test_setter, NULL);
+
+	for (i = 0; i < 1000; i++)
+	{
+		TEST(var_read_begin() == 0);
+		v = varl_get_str(test_list, "k");
+		snprintf(copy, sizeof(copy), "%s", v);
+		TEST(!*v || !strcmp(v, TEST_OLD) || !strcmp(v, TEST_NEW));
+		for (j = 0; j < 100; j++) varl_get_str(test_list, "k");
+		TEST(!strcmp(v, copy));
+		var_read_end();
+	}
+
+	__atomic_store_n(&test_stop, 1, __ATOMIC_RELEASE);
+	for (i = 0; i < 2; i++) pthread_join(t[i], NULL);
+}
+
+
+/******************************************************************************/
+/**
+ * Copy shares items with original, and changes to either are not seen
+ * by the other.
+ */
+static void test_cp(void)
+{
+	var_list_t l, c;
+
+	l = varl_new("orig");
+	varl_set_str(l, "x", "1");
+	varl_set_str(l, "y", "2");
+	c = varl_cp(l, "copy");
+	TEST(c > -1 && varl_cp(l, "copy") == -1);
+	TEST(varl_count(c) == 2 && !strcmp(varl_get_str(c, "x"), "1"));
+
+	varl_set_str(c, "x", "copy");
+	varl_rm(c, "y");
+	TEST(!strcmp(varl_get_str(l, "x"), "1") && !strcmp(varl_get_str(l, "y"), "2"));
+	TEST(!strcmp(varl_get_str(c, "x"), "copy") && !*varl_get_str(c, "y") && varl_count(c) == 1);
+
+	varl_set_str(c, "y", "back");
+	varl_rm(l, "x");
+	TEST(!strcmp(varl_get_str(c, "y"), "back") && varl_count(c) == 2);
+	TEST(!strcmp(varl_get_str(c, "x"), "copy") && varl_count(l) == 1);
+}
+
+
+/******************************************************************************/
+/**
+ * Check lists restored from snapshot.
+ */
+static void test_snapshot_check(void)
+{
+	var_list_t l = varl_find("snap");
+	const char *p;
+
+	TEST(l > 0 && varl_count(l) == 3);
+	TEST(!strcmp(varl_get_str(l, "s"), "string") && varl_get_int(l, "i") == 5);
+	p = varl_parsev(l, "t", &l, 1);
+	TEST(!strcmp(p, "[string ]"));
+	if (*p) free((void *)p);
+	varl_set_str(l, "s", "changed");
+	TEST(!strcmp(varl_get_str(l, "s"), "changed"));
+}
+
+
+/******************************************************************************/
+/**
+ * Snapshot is restored where it was saved for, or relocated if that address
+ * is taken, and truncated snapshot is rejected.
+ */
+static void test_snapshot(void)
+{
+	char path[256], bad[256];
+	var_list_t l;
+	void *block;
+	FILE *f, *b;
+	int c;
+
+	snprintf(path, sizeof(path), "%s/snapshot", test_dir);
+	snprintf(bad, sizeof(bad), "%s/truncated", test_dir);
+	l = varl_new("snap");
+	varl_set_str(l, "s", "string");
+	varl_set_int(l, "i", 5);
+	varl_set_str(l, "t", "[$s ]");
+	TEST(var_save_snapshot(path) == 0);
+
+	var_quit();
+	var_init();
+	TEST(var_load_snapshot(path) == 0);
+	test_snapshot_check();
+
+	var_quit();
+	block = mmap((void *)VAR_SNAPSHOT_BASE, 4096, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	var_init();
+	TEST(var_load_snapshot(path) == 0);
+	test_snapshot_check();
+	if (block != MAP_FAILED) munmap(block, 4096);
+
+	f = fopen(path, "rb");
+	b = fopen(bad, "wb");
+	if (f && b)
+	{
+		while ((c = fgetc(f)) != EOF) fputc(c, b);
+	}
+	if (f) fclose(f);
+	if (b)
+	{
+		fflush(b);
+		TEST(ftruncate(fileno(b), ftell(b) - 16) == 0);
+		fclose(b);
+	}
+	TEST(var_load_snapshot(bad) == -1);
+}
+
+
+/******************************************************************************/
+/**
+ * Wait for and process changes of watched files.
+ */
+static int test_watch_wait(void)
+{
+	struct pollfd pfd = { var_watch_fd(), POLLIN, 0 };
+
+	if (poll(&pfd, 1, 1000) != 1) return -1;
+	usleep(10000);
+	return var_watch_process();
+}
+
+
+/******************************************************************************/
+/**
+ * Watched file is reloaded when added, changed and removed variables.
+ */
+static void test_watch(void)
+{
+	char path[256];
+	var_list_t l;
+
+	snprintf(path, sizeof(path), "%s/watch.ini", test_dir);
+	test_write("watch.ini", "[watch]\nkeep = 1\nchange = a\nremove = me\n");
+	TEST(var_watch_file(path) == 0);
+	l = varl_find("watch");
+	TEST(l > 0 && varl_count(l) == 3);
+
+	test_write("watch.ini", "[watch]\nkeep = 1\nchange = b\nadd = new\n");
+	TEST(test_watch_wait() == 1);
+	TEST(!strcmp(varl_get_str(l, "keep"), "1") && !strcmp(varl_get_str(l, "change"), "b"));
+	TEST(!strcmp(varl_get_str(l, "add"), "new") && !*varl_get_str(l, "remove") && varl_count(l) == 3);
+
+	var_unwatch_file(path);
+}
+
+
+/******************************************************************************/
+/**
+ * Items of array list are found by index, and removing one leaves hole.
+ */
+static void test_array(void)
+{
+	var_list_t l;
+
+	l = varl_new_flags("array", VAR_LIST_ARRAY);
+	TEST(varl_append_str(l, "zero") == 0);
+	TEST(varl_append_int(l, 1) == 1);
+	TEST(varl_append_str(l, "%d", 2) == 2);
+	TEST(varl_length(l) == 3 && !strcmp(varl_get_at_str(l, 0), "zero"));
+	TEST(varl_get_at_int(l, 1) == 1 && !strcmp(varl_get_str(l, "2"), "2"));
+
+	varl_rm(l, "1");
+	TEST(!*varl_get_at_str(l, 1) && varl_length(l) == 3 && varl_count(l) == 2);
+	TEST(varl_append_str(l, "three") == 3 && !strcmp(varl_get_at_str(l, 3), "three"));
+}
+
+
+/******************************************************************************/
+/**
+ * Data given to functions taking ownership is freed also on errors.
+ */
+static void test_own(void)
+{
+	hashl_t h;
+	linkedl_t ll;
+	char *s;
+	void *d;
+
+	s = strdup(TEST_NEW);
+	TEST(varl_set_str_own(test_list, "own", s) == 0 && varl_get_str(test_list, "own") == s);
+	s = strdup(TEST_NEW);
+	TEST(varl_set_str_own(1000, "own", s) == -1 && test_freed == s);
+	s = strdup(TEST_NEW);
+	TEST(varl_set_str_own(test_list, NULL, s) == -1 && test_freed == s);
+
+	h = var_lh_new(0, NULL, NULL);
+	d = malloc(100);
+	test_malloc_fail = 0;
+	TEST(var_lh_put_own(h, "new", d, 100) == NULL && test_freed == d);
+	var_lh_free(h);
+
+	ll = var_ll_new();
+	d = malloc(100);
+	test_malloc_fail = 0;
+	TEST(var_ll_app_own(ll, d, 100) == -1 && test_freed == d);
+	TEST(var_ll_count(ll) == 0);
+	var_ll_free(ll);
+}
+
+
+/******************************************************************************/
+int main(void)
+{
+	char cmd[300];
+
+	if (var_init() || !mkdtemp(test_dir))
+	{
+		printf("Setup failed!\n");
+		return 1;
+	}
+
+	test_read();
+	test_cp();
+	test_array();
+	test_own();
+	test_watch();
+	test_snapshot();
+	var_quit();
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", test_dir);
+	if (system(cmd)) printf("Failed to remove %s\n", test_dir);
+
+	if (test_failed)
+	{
+		printf("%d checks FAILED\n", test_failed);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
+